@@ -2,4 +2,5 @@ TEMPLATE = subdirs
 
 SUBDIRS += \
     QJsonRpcClient \
-    tests
+    tests \
+    qjsonrpc-bench
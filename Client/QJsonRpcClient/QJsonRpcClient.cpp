@@ -1,6 +1,8 @@
 #include "QJsonRpcClient.h"
 
 #include <QObject>
+#include <stdexcept>
+#include <algorithm>
 QJsonRpcClient::QJsonRpcClient()
 {
 
@@ -8,6 +10,16 @@ QJsonRpcClient::QJsonRpcClient()
 
 QJsonDocument QJsonRpcClient::execute(const std::vector<QJsonRpcClient::Request> &batchRequest)
 {
+    //all or nothing, a batch must not leave a part of its ids pending
+    if(m_maxPendingCalls > 0)
+    {
+        const auto calls = std::count_if(batchRequest.begin(), batchRequest.end(), [](const Request& request){
+            return request.m_type == MethodType::DirectCall;
+        });
+        if(calls > m_maxPendingCalls - pendingCount())
+            throw std::runtime_error("Too many pending calls");
+    }
+
     QJsonArray requests;
     for(const auto& requestObject: batchRequest)
     {
@@ -32,8 +44,12 @@ QJsonDocument QJsonRpcClient::execute(const std::string &methodName,
 {
     if(type == MethodType::DirectCall)
     {
+        if(m_maxPendingCalls > 0 && pendingCount() >= m_maxPendingCalls)
+            throw std::runtime_error("Too many pending calls");
+
         //ID will begin with 1
         ++m_currentId;
+        addPending(m_currentId);
         return QJsonDocument({
                                  {"jsonrpc", "2.0"},
                                  {"method", methodName.c_str()},
@@ -57,8 +73,12 @@ QJsonDocument QJsonRpcClient::execute(const std::string &methodName, QJsonRpcCli
 {
     if(type == MethodType::DirectCall)
     {
+        if(m_maxPendingCalls > 0 && pendingCount() >= m_maxPendingCalls)
+            throw std::runtime_error("Too many pending calls");
+
         //ID will begin with 1
         ++m_currentId;
+        addPending(m_currentId);
         return QJsonDocument({
                                  {"jsonrpc", "2.0"},
                                  {"method", methodName.c_str()},
@@ -264,6 +284,210 @@ bool QJsonRpcClient::isObjectError(const QJsonObject &obj)
     return obj.keys().contains("error");
 }
 
+static const char plainMessageTag       = 'J';
+static const char compressedMessageTag  = 'Z';
+
+void QJsonRpcClient::setCompressionThreshold(int bytes)
+{
+    m_compressionThreshold = bytes;
+}
+
+int QJsonRpcClient::compressionThreshold() const
+{
+    return m_compressionThreshold;
+}
+
+QByteArray QJsonRpcClient::toMessage(const QJsonDocument &request) const
+{
+    const QByteArray json = request.toJson(QJsonDocument::Compact);
+
+    if(m_compressionThreshold <= 0)
+        return json;
+
+    if(json.size() >= m_compressionThreshold)
+        return compressedMessageTag + qCompress(json);
+    else
+        return plainMessageTag + json;
+}
+
+QJsonDocument QJsonRpcClient::fromMessage(const QByteArray &response) const
+{
+    if(response.isEmpty())
+        return QJsonDocument{};
+
+    if(response.at(0) == compressedMessageTag)
+        return QJsonDocument::fromJson(qUncompress(response.mid(1)));
+    else if(response.at(0) == plainMessageTag)
+        return QJsonDocument::fromJson(response.mid(1));
+    else
+        return QJsonDocument::fromJson(response);
+}
+
+void QJsonRpcClient::setTimeout(int milliseconds)
+{
+    m_timeout = milliseconds;
+}
+
+int QJsonRpcClient::timeout() const
+{
+    return m_timeout;
+}
+
+void QJsonRpcClient::setMaxPendingCalls(int limit)
+{
+    m_maxPendingCalls = limit;
+}
+
+int QJsonRpcClient::maxPendingCalls() const
+{
+    return m_maxPendingCalls;
+}
+
+int QJsonRpcClient::pendingCount() const
+{
+    return static_cast<int>(m_pending.size());
+}
+
+bool QJsonRpcClient::isPending(int id) const
+{
+    return m_pending.find(id) != m_pending.end();
+}
+
+void QJsonRpcClient::complete(const QJsonDocument &response)
+{
+    if(response.isArray())
+    {
+        for(const auto& responseObject: response.array())
+        {
+            const QJsonValue id = responseObject.toObject().value("id");
+            if(id.isDouble())
+                m_pending.erase(id.toInt());
+        }
+    }
+    else if(response.isObject())
+    {
+        const QJsonValue id = response.object().value("id");
+        if(id.isDouble())
+            m_pending.erase(id.toInt());
+    }
+}
+
+std::vector<int> QJsonRpcClient::expire()
+{
+    std::vector<int> expired;
+
+    for(auto it = m_pending.begin(); it != m_pending.end();)
+    {
+        if(it->second.hasExpired())
+        {
+            expired.push_back(it->first);
+            it = m_pending.erase(it);
+        }
+        else
+            ++it;
+    }
+
+    return expired;
+}
+
+QJsonDocument QJsonRpcClient::cancel(int id)
+{
+    m_pending.erase(id);
+
+    return execute("$/cancelRequest", QJsonObject{{"id", id}}, MethodType::Notification);
+}
+
+void QJsonRpcClient::setPartialResultHandler(QJsonRpcClient::PartialResultHandler &&handler)
+{
+    m_partialResultHandler = std::move(handler);
+}
+
+bool QJsonRpcClient::isPartialResult(const QJsonDocument &message) const
+{
+    if(!message.isObject())
+        return false;
+
+    const QJsonObject obj = message.object();
+    return obj.value("method").toString() == QString("$/partialResult") &&
+           obj.value("params").isObject() &&
+           obj.value("id").isUndefined();
+}
+
+bool QJsonRpcClient::handlePartialResult(const QJsonDocument &message)
+{
+    if(!isPartialResult(message))
+        return false;
+
+    const QJsonObject params = message.object().value("params").toObject();
+    const QJsonValue id = params.value("id");
+
+    //a partial result shows the call is alive
+    if(id.isDouble())
+    {
+        auto it = m_pending.find(id.toInt());
+        if(it != m_pending.end() && m_timeout > 0)
+            it->second = QDeadlineTimer(m_timeout);
+    }
+
+    if(m_partialResultHandler)
+        m_partialResultHandler(id, params.value("value"));
+
+    return true;
+}
+
+void QJsonRpcClient::setTransport(QJsonRpcClient::Transport &&transport)
+{
+    m_transport = std::move(transport);
+}
+
+bool QJsonRpcClient::hasTransport() const
+{
+    return static_cast<bool>(m_transport);
+}
+
+QJsonDocument QJsonRpcClient::call(const std::vector<QJsonRpcClient::Request> &batchRequest)
+{
+    return send(execute(batchRequest));
+}
+
+QJsonDocument QJsonRpcClient::call(const QJsonRpcClient::Request &request)
+{
+    return send(execute(request));
+}
+
+QJsonDocument QJsonRpcClient::call(const std::string &methodName, const QJsonValue &params,
+                                   QJsonRpcClient::MethodType type)
+{
+    return send(execute(methodName, params, type));
+}
+
+QJsonDocument QJsonRpcClient::call(const std::string &methodName, QJsonRpcClient::MethodType type)
+{
+    return send(execute(methodName, type));
+}
+
+QJsonDocument QJsonRpcClient::send(const QJsonDocument &request)
+{
+    if(!m_transport)
+        throw std::logic_error("Transport is not set");
+
+    const QJsonDocument response = m_transport(request);
+    complete(response);
+    return response;
+}
+
+void QJsonRpcClient::addPending(int id)
+{
+    //without a timeout or a limit nobody would ever free the state
+    if(m_timeout <= 0 && m_maxPendingCalls <= 0)
+        return;
+
+    if(m_timeout > 0)
+        m_pending.emplace(id, QDeadlineTimer(m_timeout));
+    else
+        m_pending.emplace(id, QDeadlineTimer(QDeadlineTimer::Forever));
+}
+
 
 
 QJsonRpcClient::Request::Request(const std::string &methodName, const QJsonValue &params, const QJsonRpcClient::MethodType type)
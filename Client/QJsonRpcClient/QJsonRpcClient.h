@@ -3,8 +3,12 @@
 #include <QJsonDocument>
 #include <QJsonArray>
 #include <QJsonObject>
+#include <QByteArray>
+#include <QDeadlineTimer>
 #include <string>
 #include <vector>
+#include <map>
+#include <functional>
 
 class QJsonRpcClient
 {
@@ -38,8 +42,75 @@ public:
 
     std::vector<bool> validateBatch(const QJsonDocument& response);
     bool isBatch(const QJsonDocument& response);
+
+    /*
+        Wire framing, see QJsonRpcServer::executeMessage.
+        With compression disabled messages are plain compact JSON text.
+        Otherwise they are tagged 'J' (plain) or 'Z' (qCompress), which also
+        tells the server that compressed responses are accepted.
+    */
+    void setCompressionThreshold(int bytes);
+    int compressionThreshold() const;
+    QByteArray toMessage(const QJsonDocument& request) const;
+    QJsonDocument fromMessage(const QByteArray& response) const;
+
+    /*
+        Pending calls, tracked only while a timeout or a pending limit is set.
+        Every DirectCall request is pending until its response is passed to
+        complete(), it is cancelled or its timeout is over.
+    */
+    void setTimeout(int milliseconds); //0 - calls never time out
+    int timeout() const;
+    //DirectCall over the limit throws std::runtime_error, 0 - unlimited
+    void setMaxPendingCalls(int limit);
+    int maxPendingCalls() const;
+    int pendingCount() const;
+    bool isPending(int id) const;
+    void complete(const QJsonDocument& response);
+    //Forgets timed out calls and returns their ids
+    std::vector<int> expire();
+    //Forgets the call and returns $/cancelRequest notification for the server
+    QJsonDocument cancel(int id);
+
+    /*
+        Streaming results.
+        <-- {"jsonrpc": "2.0", "method": "$/partialResult", "params": {"id": <call id>, "value": value}}
+        Partial results of a call come before its final response.
+    */
+    using PartialResultHandler = std::function<void(const QJsonValue& id, const QJsonValue& value)>;
+    void setPartialResultHandler(PartialResultHandler&& handler);
+    bool isPartialResult(const QJsonDocument& message) const;
+    //Passes a partial result to the handler, returns false for other messages
+    bool handlePartialResult(const QJsonDocument& message);
+
+    /*
+        Direct channel to a server, e.g. QJsonRpcServer::localTransport() of a
+        server in the same process. Documents are handed over as they are,
+        without text encoding; ids, errors and batches are the same as on the wire.
+    */
+    using Transport = std::function<QJsonDocument(const QJsonDocument& request)>;
+    void setTransport(Transport&& transport);
+    bool hasTransport() const;
+    //Builds the request, sends it with the transport and completes the call.
+    //Notifications return an empty document. Throws std::logic_error without a transport
+    QJsonDocument call(const std::vector<Request>& batchRequest);
+    QJsonDocument call(const Request& request);
+    QJsonDocument call(const std::string& methodName,
+                       const QJsonValue& params,
+                       MethodType type = MethodType::DirectCall);
+    QJsonDocument call(const std::string& methodName,
+                       MethodType type = MethodType::DirectCall);
 private:
     int m_currentId {0};
+    int m_compressionThreshold {0}; //0 - compression is disabled
+    int m_timeout {0};
+    int m_maxPendingCalls {0};
+    std::map<int, QDeadlineTimer> m_pending;
+    PartialResultHandler m_partialResultHandler;
+    Transport m_transport;
+
+    void addPending(int id);
+    QJsonDocument send(const QJsonDocument& request);
 
     bool validateObject(const QJsonObject& obj);
     bool isObjectError(const QJsonObject& obj);
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <QtGlobal>
+#include <QTextStream>
+#include <vector>
+#include <algorithm>
+
+
+/*
+    High dynamic range latency histogram in the spirit of HdrHistogram:
+    values are kept with 3 significant decimal digits from 1 up to maxValue
+    in a fixed array, recording is O(1) and histograms of several threads
+    can be merged.
+*/
+class HdrHistogram
+{
+public:
+    explicit HdrHistogram(qint64 maxValue = 3600LL * 1000 * 1000)
+    {
+        int buckets = 1;
+        while((static_cast<qint64>(subBucketCount) << (buckets - 1)) <= maxValue)
+            ++buckets;
+        m_counts.assign(static_cast<size_t>(subBucketCount + (buckets - 1) * subBucketHalfCount), 0);
+    }
+
+    void record(qint64 value)
+    {
+        const size_t index = std::min(indexOf(std::max<qint64>(value, 0)), m_counts.size() - 1);
+        ++m_counts[index];
+        ++m_total;
+        m_max = std::max(m_max, value);
+    }
+
+    void merge(const HdrHistogram& other)
+    {
+        const size_t count = std::min(m_counts.size(), other.m_counts.size());
+        for(size_t i = 0; i < count; ++i)
+            m_counts[i] += other.m_counts[i];
+        m_total += other.m_total;
+        m_max = std::max(m_max, other.m_max);
+    }
+
+    quint64 count() const
+    {
+        return m_total;
+    }
+
+    qint64 max() const
+    {
+        return m_max;
+    }
+
+    //Highest value equivalent to the percentile, percentile in [0, 100]
+    qint64 valueAtPercentile(double percentile) const
+    {
+        if(m_total == 0)
+            return 0;
+
+        const quint64 target = std::max<quint64>(1, static_cast<quint64>(percentile / 100.0 * m_total + 0.5));
+        quint64 cumulative = 0;
+        for(size_t i = 0; i < m_counts.size(); ++i)
+        {
+            cumulative += m_counts[i];
+            if(cumulative >= target)
+                return std::min(highestEquivalentValue(i), m_max);
+        }
+        return m_max;
+    }
+
+    //Percentile distribution in the HdrHistogram text format
+    void print(QTextStream& out, double unitScale = 1.0) const
+    {
+        out << "       Value   Percentile   TotalCount 1/(1-Percentile)\n\n";
+
+        quint64 cumulative = 0;
+        double nextPercentile = 0;
+        for(size_t i = 0; i < m_counts.size() && m_total > 0; ++i)
+        {
+            if(m_counts[i] == 0)
+                continue;
+
+            cumulative += m_counts[i];
+            const double percentile = 100.0 * cumulative / m_total;
+            if(percentile < nextPercentile && cumulative != m_total)
+                continue;
+
+            const double fraction = percentile / 100.0;
+            out << qSetFieldWidth(12) << std::min(highestEquivalentValue(i), m_max) / unitScale
+                << qSetFieldWidth(13) << fraction
+                << qSetFieldWidth(13) << cumulative;
+            if(fraction < 1.0)
+                out << qSetFieldWidth(17) << 1.0 / (1.0 - fraction);
+            out << qSetFieldWidth(0) << '\n';
+
+            //halve the distance to 100% with every tick
+            nextPercentile = percentile + (100.0 - percentile) / 2;
+        }
+
+        out << "#[Mean    = " << mean() / unitScale << ", Max = " << m_max / unitScale << "]\n"
+            << "#[Total count = " << m_total << "]\n";
+    }
+
+    double mean() const
+    {
+        if(m_total == 0)
+            return 0;
+
+        double sum = 0;
+        for(size_t i = 0; i < m_counts.size(); ++i)
+            sum += static_cast<double>(m_counts[i]) * highestEquivalentValue(i);
+        return sum / m_total;
+    }
+
+private:
+    //2048 sub-buckets keep 3 significant digits
+    static constexpr int subBucketCount {2048};
+    static constexpr int subBucketHalfCount {subBucketCount / 2};
+
+    static int bucketOf(qint64 value)
+    {
+        int bucket = 0;
+        while((value >> bucket) >= subBucketCount)
+            ++bucket;
+        return bucket;
+    }
+
+    static size_t indexOf(qint64 value)
+    {
+        const int bucket = bucketOf(value);
+        const qint64 subBucket = value >> bucket;
+        if(bucket == 0)
+            return static_cast<size_t>(subBucket);
+
+        return static_cast<size_t>(subBucketCount + (bucket - 1) * subBucketHalfCount
+                                   + (subBucket - subBucketHalfCount));
+    }
+
+    static qint64 highestEquivalentValue(size_t index)
+    {
+        if(index < static_cast<size_t>(subBucketCount))
+            return static_cast<qint64>(index);
+
+        const size_t offset = index - subBucketCount;
+        const int bucket = static_cast<int>(offset / subBucketHalfCount) + 1;
+        const qint64 subBucket = static_cast<qint64>(offset % subBucketHalfCount) + subBucketHalfCount;
+        return ((subBucket + 1) << bucket) - 1;
+    }
+
+    std::vector<quint64> m_counts;
+    quint64 m_total {0};
+    qint64 m_max {0};
+};
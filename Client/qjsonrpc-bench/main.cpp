@@ -0,0 +1,448 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTcpSocket>
+#include <QTextStream>
+#include <QtEndian>
+#ifdef QJSONRPC_WEBSOCKETS
+#include <QEventLoop>
+#include <QUrl>
+#include <QWebSocket>
+#endif
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+#include "QJsonRpcClient.h"
+#include "QJsonRpcServer.h"
+#include "HdrHistogram.h"
+
+/*
+    qjsonrpc-bench [options] [host port]
+
+    Load generator for JSON-RPC servers. Without host and port the requests
+    go to an in-process QJsonRpcServer with "echo" and "subtract" methods,
+    otherwise to a newline delimited TCP endpoint (QJsonRpcSocketTransport),
+    or with --http to a QJsonRpcHttpServer, one keep-alive connection each,
+    or with --ws to a QJsonRpcWebSocketServer in binary frames (when built
+    with Qt WebSockets).
+
+    Closed loop: every connection sends the next request when the previous
+    one is answered. Open loop (--rate): requests are due at a constant rate
+    and latency is measured from the time a request was due, so a slow
+    server is not hidden by the generator slowing down with it.
+    A request is one message, a single call or a batch of --batch calls,
+    throughput is reported in requests and in calls per second.
+
+    --compress N sets the compression threshold of the client and of the
+    in-process server, a remote server uses its own setting. Compressed TCP
+    lines carry 'Z' + base64 as QJsonRpcSocketTransport expects them, HTTP
+    bodies are sent with "Content-Encoding: deflate" and WebSocket frames
+    carry the 'Z' tag.
+*/
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Transport = std::function<QByteArray(const QByteArray& message)>;
+
+struct MethodWeight {
+    std::string name;
+    int weight;
+};
+
+enum class Target {
+    Tcp,
+    Http,
+    WebSocket
+};
+
+struct Settings {
+    std::vector<MethodWeight> mix;
+    int batchSize {1};
+    int payloadSize {0};
+    int connections {1};
+    double rate {0}; //requests per second over all connections, 0 - closed loop
+    double duration {10};
+    double warmup {1};
+    int compressionThreshold {0}; //0 - compression is disabled
+    Target target {Target::Tcp};
+    QString host;
+    quint16 port {0};
+};
+
+struct Totals {
+    std::atomic<quint64> requests {0};
+    std::atomic<quint64> calls {0};     //requests * batch size
+    std::atomic<quint64> errors {0};
+};
+
+QString targetName(Target target)
+{
+    switch(target)
+    {
+    case Target::Tcp:
+        return "tcp";
+    case Target::Http:
+        return "http";
+    case Target::WebSocket:
+        return "ws";
+    }
+    return {};
+}
+
+std::vector<MethodWeight> parseMix(const QString& mix)
+{
+    //"subtract=3,echo=1"
+    std::vector<MethodWeight> methods;
+    for(const QString& entry: mix.split(',', Qt::SkipEmptyParts))
+    {
+        const QStringList parts = entry.split('=');
+        const int weight = parts.size() > 1 ? parts.at(1).toInt() : 1;
+        if(weight > 0)
+            methods.push_back(MethodWeight{parts.at(0).trimmed().toStdString(), weight});
+    }
+    return methods;
+}
+
+QJsonRpcServer& inProcessServer(const Settings& settings)
+{
+    static QJsonRpcServer* server = [&settings]{
+        auto server = new QJsonRpcServer();
+        server->setCompressionThreshold(settings.compressionThreshold);
+        server->addMethodVariadicParameters("echo", [](const QVariantList& args) -> QVariant {
+            return args;
+        });
+        server->addMethod("subtract", {"subtrahend", "minuend"}, [](const QVariantList& args) -> QVariant {
+            return args[0].toInt() - args[1].toInt();
+        });
+        return server;
+    }();
+    return *server;
+}
+
+QByteArray readLine(QTcpSocket& socket)
+{
+    while(!socket.canReadLine())
+        if(!socket.waitForReadyRead())
+            throw std::runtime_error("read failed");
+    return socket.readLine();
+}
+
+//'Z' framing of a deflated body, the size only sizes the first qUncompress buffer
+QByteArray compressedMessage(const QByteArray& body)
+{
+    QByteArray message(5, 'Z');
+    qToBigEndian<quint32>(static_cast<quint32>(body.size()), message.data() + 1);
+    return message + body;
+}
+
+Transport httpTransport(const std::shared_ptr<QTcpSocket>& socket, const Settings& settings)
+{
+    const QByteArray host = settings.host.toUtf8() + ':' + QByteArray::number(settings.port);
+
+    return [socket, host, &settings](const QByteArray& message){
+        QByteArray head = "POST / HTTP/1.1\r\nHost: " + host + "\r\nContent-Type: application/json\r\n";
+        QByteArray body;
+        if(message.startsWith('Z'))
+        {
+            //qCompress data is the zlib stream after a 4 byte size
+            body = message.mid(5);
+            head += "Content-Encoding: deflate\r\n";
+        }
+        else
+        {
+            body = message.startsWith('J') ? message.mid(1) : message;
+        }
+        if(settings.compressionThreshold > 0)
+            head += "Accept-Encoding: deflate\r\n";
+        head += "Content-Length: " + QByteArray::number(body.size()) + "\r\n\r\n";
+        socket->write(head + body);
+
+        const QByteArray status = readLine(*socket).trimmed();
+        if(!status.startsWith("HTTP/1.1 200"))
+            throw std::runtime_error(status.toStdString());
+
+        qint64 length = 0;
+        bool deflated = false;
+        for(QByteArray line = readLine(*socket).trimmed(); !line.isEmpty(); line = readLine(*socket).trimmed())
+        {
+            const int colon = line.indexOf(':');
+            const QByteArray name = line.left(colon).trimmed().toLower();
+            const QByteArray value = line.mid(colon + 1).trimmed();
+            if(name == "content-length")
+                length = value.toLongLong();
+            else if(name == "content-encoding")
+                deflated = value.toLower() == "deflate";
+        }
+
+        while(socket->bytesAvailable() < length)
+            if(!socket->waitForReadyRead())
+                throw std::runtime_error("read failed");
+
+        const QByteArray response = socket->read(length);
+        return deflated ? compressedMessage(response) : response;
+    };
+}
+
+#ifdef QJSONRPC_WEBSOCKETS
+//QWebSocket has no blocking API, the worker thread spins a local event loop per call
+Transport webSocketTransport(const Settings& settings)
+{
+    auto socket = std::make_shared<QWebSocket>();
+    auto loop = std::make_shared<QEventLoop>();
+    auto response = std::make_shared<QByteArray>();
+
+    QObject::connect(socket.get(), &QWebSocket::stateChanged, loop.get(), [loop = loop.get()](QAbstractSocket::SocketState state){
+        if(state == QAbstractSocket::ConnectedState || state == QAbstractSocket::UnconnectedState)
+            loop->quit();
+    });
+    QObject::connect(socket.get(), &QWebSocket::binaryMessageReceived, loop.get(), [response, loop = loop.get()](const QByteArray& message){
+        *response = message;
+        loop->quit();
+    });
+
+    socket->open(QUrl(QString("ws://%1:%2").arg(settings.host).arg(settings.port)));
+    loop->exec();
+    if(socket->state() != QAbstractSocket::ConnectedState)
+        throw std::runtime_error(socket->errorString().toStdString());
+
+    return [socket, loop, response](const QByteArray& message){
+        response->clear();
+        socket->sendBinaryMessage(message);
+        loop->exec();
+        if(socket->state() != QAbstractSocket::ConnectedState)
+            throw std::runtime_error("connection closed");
+        return *response;
+    };
+}
+#endif
+
+Transport connectTransport(const Settings& settings)
+{
+    if(settings.host.isEmpty())
+    {
+        return [&settings](const QByteArray& message){
+            return inProcessServer(settings).executeMessage(message);
+        };
+    }
+
+#ifdef QJSONRPC_WEBSOCKETS
+    if(settings.target == Target::WebSocket)
+        return webSocketTransport(settings);
+#endif
+
+    auto socket = std::make_shared<QTcpSocket>();
+    socket->connectToHost(settings.host, settings.port);
+    if(!socket->waitForConnected())
+        throw std::runtime_error(socket->errorString().toStdString());
+
+    if(settings.target == Target::Http)
+        return httpTransport(socket, settings);
+
+    return [socket](const QByteArray& message){
+        //compressed data may contain a newline
+        if(message.startsWith('Z'))
+            socket->write('Z' + message.mid(1).toBase64());
+        else
+            socket->write(message);
+        socket->write("\n", 1);
+
+        const QByteArray line = readLine(*socket).trimmed();
+        if(line.startsWith('Z'))
+            return 'Z' + QByteArray::fromBase64(line.mid(1));
+        return line;
+    };
+}
+
+void runConnection(const Settings& settings, int connection, const Clock::time_point start,
+                   HdrHistogram& histogram, Totals& totals)
+{
+    const Transport transport = connectTransport(settings);
+    QJsonRpcClient client;
+    client.setCompressionThreshold(settings.compressionThreshold);
+
+    std::mt19937 random(static_cast<unsigned>(connection + 1));
+    std::vector<int> weights;
+    for(const auto& method: settings.mix)
+        weights.push_back(method.weight);
+    std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+
+    const QJsonValue payload(QString(settings.payloadSize, 'x'));
+
+    //open loop: connection k sends requests k, k + connections, ...
+    const auto interval = settings.rate > 0
+            ? std::chrono::duration<double>(settings.connections / settings.rate)
+            : std::chrono::duration<double>(0);
+    const auto offset = settings.rate > 0
+            ? std::chrono::duration<double>(connection / settings.rate)
+            : std::chrono::duration<double>(0);
+
+    const Clock::time_point measureFrom = start + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(settings.warmup));
+    const Clock::time_point end = measureFrom + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(settings.duration));
+
+    for(quint64 sent = 0;; ++sent)
+    {
+        Clock::time_point due = Clock::now();
+        if(settings.rate > 0)
+        {
+            due = start + std::chrono::duration_cast<Clock::duration>(offset + interval * static_cast<double>(sent));
+            std::this_thread::sleep_until(due);
+        }
+        if(due >= end)
+            break;
+
+        std::vector<QJsonRpcClient::Request> batch;
+        batch.reserve(static_cast<size_t>(settings.batchSize));
+        for(int i = 0; i < settings.batchSize; ++i)
+        {
+            const std::string& method = settings.mix[pick(random)].name;
+            const QJsonArray params = method == "subtract" ? QJsonArray{42, 23} : QJsonArray{payload};
+            batch.emplace_back(method, params);
+        }
+
+        const QJsonDocument request = settings.batchSize == 1 ? client.execute(batch.front())
+                                                              : client.execute(batch);
+
+        bool failed = false;
+        try {
+            const QJsonDocument response = client.fromMessage(transport(client.toMessage(request)));
+            failed = !client.validate(response) || client.isError(response);
+        }
+        catch(const std::exception&)
+        {
+            failed = true;
+        }
+
+        if(due < measureFrom)
+            continue;
+
+        histogram.record(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - due).count());
+        ++totals.requests;
+        totals.calls += static_cast<quint64>(settings.batchSize);
+        if(failed)
+            ++totals.errors;
+    }
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("qjsonrpc-bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("JSON-RPC load generator with closed and open loop modes");
+    parser.addHelpOption();
+    parser.addPositionalArgument("host port", "TCP endpoint, in-process server when omitted", "[host port]");
+    const QCommandLineOption httpOption("http", "Send HTTP POST requests to host port");
+    const QCommandLineOption wsOption("ws", "Send WebSocket binary frames to host port");
+    const QCommandLineOption mixOption("mix", "Method mix, name=weight,...", "mix", "subtract=1");
+    const QCommandLineOption batchOption("batch", "Calls per request", "N", "1");
+    const QCommandLineOption payloadOption("payload", "Bytes of the string parameter of non-subtract methods", "bytes", "0");
+    const QCommandLineOption connectionsOption("connections", "Concurrent connections", "N", "1");
+    const QCommandLineOption rateOption("rate", "Open loop: requests per second over all connections", "R", "0");
+    const QCommandLineOption durationOption("duration", "Measured seconds", "s", "10");
+    const QCommandLineOption warmupOption("warmup", "Seconds before measuring", "s", "1");
+    const QCommandLineOption compressOption("compress", "Compress messages of at least this size", "bytes", "0");
+    parser.addOptions({mixOption, batchOption, payloadOption, connectionsOption,
+                       rateOption, durationOption, warmupOption, compressOption, httpOption, wsOption});
+    parser.process(app);
+
+    Settings settings;
+    settings.mix = parseMix(parser.value(mixOption));
+    settings.batchSize = std::max(1, parser.value(batchOption).toInt());
+    settings.payloadSize = std::max(0, parser.value(payloadOption).toInt());
+    settings.connections = std::max(1, parser.value(connectionsOption).toInt());
+    settings.rate = parser.value(rateOption).toDouble();
+    settings.duration = parser.value(durationOption).toDouble();
+    settings.warmup = parser.value(warmupOption).toDouble();
+    settings.compressionThreshold = std::max(0, parser.value(compressOption).toInt());
+    if(parser.isSet(httpOption) && parser.isSet(wsOption))
+        parser.showHelp(1);
+    if(parser.isSet(httpOption))
+        settings.target = Target::Http;
+    if(parser.isSet(wsOption))
+    {
+#ifdef QJSONRPC_WEBSOCKETS
+        settings.target = Target::WebSocket;
+#else
+        QTextStream(stderr) << "Built without Qt WebSockets\n";
+        return 1;
+#endif
+    }
+
+    const QStringList arguments = parser.positionalArguments();
+    if(arguments.size() == 2)
+    {
+        settings.host = arguments.at(0);
+        settings.port = static_cast<quint16>(arguments.at(1).toUInt());
+    }
+    else if(!arguments.isEmpty())
+    {
+        parser.showHelp(1);
+    }
+
+    if(settings.target != Target::Tcp && settings.host.isEmpty())
+    {
+        QTextStream(stderr) << "--http and --ws need host and port\n";
+        return 1;
+    }
+
+    if(settings.mix.empty())
+    {
+        QTextStream(stderr) << "Empty method mix\n";
+        return 1;
+    }
+
+    //created before the workers start
+    if(settings.host.isEmpty())
+        inProcessServer(settings);
+
+    std::vector<HdrHistogram> histograms(static_cast<size_t>(settings.connections));
+    Totals totals;
+    const Clock::time_point start = Clock::now();
+
+    std::vector<std::thread> threads;
+    for(int i = 0; i < settings.connections; ++i)
+    {
+        threads.emplace_back([&, i]{
+            try {
+                runConnection(settings, i, start, histograms[static_cast<size_t>(i)], totals);
+            }
+            catch(const std::exception& exc)
+            {
+                QTextStream(stderr) << "connection " << i << ": " << exc.what() << '\n';
+            }
+        });
+    }
+    for(auto& thread: threads)
+        thread.join();
+
+    HdrHistogram histogram;
+    for(const auto& connection: histograms)
+        histogram.merge(connection);
+
+    QTextStream out(stdout);
+    out << "mode        " << (settings.rate > 0 ? "open loop" : "closed loop") << '\n'
+        << "target      " << (settings.host.isEmpty() ? QString("in-process")
+                                                      : targetName(settings.target) + ' ' + settings.host + ':' + QString::number(settings.port)) << '\n'
+        << "compression " << (settings.compressionThreshold > 0 ? QString::number(settings.compressionThreshold) + " bytes" : QString("off")) << '\n'
+        << "requests    " << totals.requests << '\n'
+        << "calls       " << totals.calls << '\n'
+        << "errors      " << totals.errors << " requests\n"
+        << "throughput  " << totals.requests / settings.duration << " req/s, "
+                          << totals.calls / settings.duration << " calls/s\n"
+        << "p50         " << histogram.valueAtPercentile(50) << " us\n"
+        << "p99         " << histogram.valueAtPercentile(99) << " us\n"
+        << "p99.9       " << histogram.valueAtPercentile(99.9) << " us\n"
+        << "max         " << histogram.max() << " us\n\n";
+    histogram.print(out, 1000.0);
+
+    return 0;
+}
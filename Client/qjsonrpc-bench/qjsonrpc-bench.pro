@@ -0,0 +1,30 @@
+TEMPLATE = app
+TARGET = qjsonrpc-bench
+
+QT = core network
+
+CONFIG += console
+CONFIG += thread
+CONFIG += c++17
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../QJsonRpcClient
+INCLUDEPATH += ../../Server/QJsonRpcServer
+
+HEADERS += \
+        HdrHistogram.h
+
+SOURCES += \
+        main.cpp \
+        ../QJsonRpcClient/QJsonRpcClient.cpp \
+        ../../Server/QJsonRpcServer/QJsonRpcServer.cpp \
+        ../../Server/QJsonRpcServer/QJsonRpcResultCache.cpp \
+        ../../Server/QJsonRpcServer/QJsonRpcSingleFlight.cpp \
+        ../../Server/QJsonRpcServer/QJsonRpcScheduler.cpp \
+        ../../Server/QJsonRpcServer/QJsonRpcCallContext.cpp \
+        ../../Server/QJsonRpcServer/QJsonRpcParams.cpp
+
+qtHaveModule(websockets) {
+    QT += websockets
+    DEFINES += QJSONRPC_WEBSOCKETS
+}
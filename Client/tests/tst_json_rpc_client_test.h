@@ -463,3 +463,198 @@ TEST(Json_RPC_Clent_batch, Validate_INVALID_batch)
 }
 
 
+
+TEST(Json_RPC_Clent, Message_compression_disabled)
+{
+    //Arrnge
+    QJsonRpcClient rpc;
+    QJsonDocument request = rpc.execute("myMethod", QJsonArray{1, 2, 3});
+    QByteArray result;
+
+    //Act
+    result = rpc.toMessage(request);
+
+    //Assert
+    ASSERT_EQ(result, request.toJson(QJsonDocument::Compact));
+}
+
+TEST(Json_RPC_Clent, Message_compression_threshold)
+{
+    //Arrnge
+    QJsonRpcClient rpc;
+    QJsonArray big;
+    for(int i = 0; i < 10000; ++i)
+        big.append(i);
+    QJsonDocument small_request = rpc.execute("myMethod", QJsonArray{1, 2, 3});
+    QJsonDocument big_request = rpc.execute("myMethod", big);
+    QByteArray small_result;
+    QByteArray big_result;
+
+    rpc.setCompressionThreshold(1024);
+
+    //Act
+    small_result = rpc.toMessage(small_request);
+    big_result = rpc.toMessage(big_request);
+
+    //Assert
+    ASSERT_FALSE(small_result.isEmpty());
+    ASSERT_FALSE(big_result.isEmpty());
+    EXPECT_EQ(small_result.at(0), 'J');
+    EXPECT_EQ(big_result.at(0), 'Z');
+    EXPECT_LT(big_result.size(), big_request.toJson(QJsonDocument::Compact).size());
+    EXPECT_EQ(rpc.fromMessage(small_result), small_request);
+    EXPECT_EQ(rpc.fromMessage(big_result), big_request);
+}
+
+TEST(Json_RPC_Clent, Pending_calls_timeout)
+{
+    //Arrnge
+    QJsonRpcClient rpc;
+    std::vector<int> expired;
+    rpc.setTimeout(1);
+
+    //Act
+    rpc.execute("first");
+    rpc.execute("second");
+    rpc.complete(QJsonDocument({{"jsonrpc", "2.0"}, {"result", 19}, {"id", 1}}));
+    while(expired.empty()) //second one times out after 1 ms
+        expired = rpc.expire();
+
+    //Assert
+    EXPECT_EQ(expired, std::vector<int>{2});
+    EXPECT_FALSE(rpc.isPending(1));
+    EXPECT_FALSE(rpc.isPending(2));
+    EXPECT_EQ(rpc.pendingCount(), 0);
+}
+
+TEST(Json_RPC_Clent, Pending_calls_cancel)
+{
+    //Arrnge
+    QJsonRpcClient rpc;
+    QJsonDocument cancel_request ({{"jsonrpc", "2.0"},
+                                   {"method", "$/cancelRequest"},
+                                   {"params", QJsonObject{{"id", 1}}}
+                                  });
+    QJsonDocument result;
+    rpc.setTimeout(60000);
+
+    //Act
+    rpc.execute("first");
+    result = rpc.cancel(1);
+
+    //Assert
+    EXPECT_EQ(result, cancel_request);
+    EXPECT_FALSE(rpc.isPending(1));
+    EXPECT_EQ(rpc.pendingCount(), 0);
+}
+
+TEST(Json_RPC_Clent, Pending_calls_not_tracked_without_timeout)
+{
+    //Arrnge
+    QJsonRpcClient rpc;
+
+    //Act
+    rpc.execute("first");
+
+    //Assert
+    EXPECT_EQ(rpc.pendingCount(), 0);
+}
+
+TEST(Json_RPC_Clent, Partial_result)
+{
+    //Arrnge
+    QJsonRpcClient rpc;
+    QJsonDocument partial ({{"jsonrpc", "2.0"},
+                            {"method", "$/partialResult"},
+                            {"params", QJsonObject{{"id", 1}, {"value", QJsonArray{1, 2}}}}
+                           });
+    QJsonDocument final_response ({{"jsonrpc", "2.0"}, {"result", 2}, {"id", 1}});
+    QJsonValue received_id;
+    QJsonValue received_value;
+
+    rpc.setPartialResultHandler([&](const QJsonValue& id, const QJsonValue& value){
+        received_id = id;
+        received_value = value;
+    });
+
+    //Act
+    rpc.execute("stream");
+    bool partial_handled = rpc.handlePartialResult(partial);
+    bool final_handled = rpc.handlePartialResult(final_response);
+
+    //Assert
+    EXPECT_TRUE(partial_handled);
+    EXPECT_FALSE(final_handled);
+    EXPECT_EQ(received_id, QJsonValue(1));
+    EXPECT_EQ(received_value, QJsonValue(QJsonArray{1, 2}));
+}
+
+TEST(Json_RPC_Clent, Pending_calls_limit)
+{
+    //Arrnge
+    QJsonRpcClient rpc;
+    rpc.setMaxPendingCalls(2);
+
+    //Act
+    rpc.execute("first");
+    rpc.execute("second");
+
+    //Assert
+    EXPECT_THROW(rpc.execute("third"), std::runtime_error);
+    rpc.complete(QJsonDocument({{"jsonrpc", "2.0"}, {"result", 19}, {"id", 1}}));
+    EXPECT_NO_THROW(rpc.execute("third"));
+}
+
+TEST(Json_RPC_Clent_batch, Pending_calls_limit_batch)
+{
+    //Arrnge
+    QJsonRpcClient rpc;
+    rpc.setMaxPendingCalls(2);
+    rpc.execute("first");
+
+    //Act
+    EXPECT_THROW(rpc.execute(std::vector<QJsonRpcClient::Request>{
+                                 QJsonRpcClient::Request{"second", QJsonRpcClient::MethodType::DirectCall},
+                                 QJsonRpcClient::Request{"third", QJsonRpcClient::MethodType::DirectCall},
+                             }), std::runtime_error);
+
+    //Assert
+    EXPECT_EQ(rpc.pendingCount(), 1);
+    EXPECT_NO_THROW(rpc.execute(std::vector<QJsonRpcClient::Request>{
+                                    QJsonRpcClient::Request{"second", QJsonRpcClient::MethodType::DirectCall},
+                                    QJsonRpcClient::Request{"notify", QJsonRpcClient::MethodType::Notification},
+                                }));
+    EXPECT_EQ(rpc.pendingCount(), 2);
+}
+
+TEST(Json_RPC_Clent, Call_through_transport)
+{
+    //Arrnge
+    QJsonRpcClient rpc;
+    rpc.setTimeout(1000);
+    QJsonDocument sent;
+    rpc.setTransport([&](const QJsonDocument& request){
+        sent = request;
+        return QJsonDocument({{"jsonrpc", "2.0"}, {"result", 19}, {"id", request.object().value("id")}});
+    });
+
+    //Act
+    const QJsonDocument response = rpc.call("subtract", QJsonArray{42, 23});
+
+    //Assert
+    EXPECT_EQ(sent, QJsonDocument({{"jsonrpc", "2.0"}, {"method", "subtract"},
+                                   {"params", QJsonArray{42, 23}}, {"id", 1}}));
+    EXPECT_EQ(response, QJsonDocument({{"jsonrpc", "2.0"}, {"result", 19}, {"id", 1}}));
+    EXPECT_EQ(rpc.pendingCount(), 0);
+}
+
+TEST(Json_RPC_Clent, Call_without_transport)
+{
+    //Arrnge
+    QJsonRpcClient rpc;
+
+    //Act
+    //Assert
+    EXPECT_FALSE(rpc.hasTransport());
+    EXPECT_THROW(rpc.call("subtract"), std::logic_error);
+}
@@ -0,0 +1,159 @@
+#include "QJsonRpcCallContext.h"
+
+#include <QMutexLocker>
+#include <QJsonObject>
+
+QJsonRpcCancellationToken QJsonRpcCancellationToken::create()
+{
+    QJsonRpcCancellationToken token;
+    token.m_state = std::make_shared<State>();
+    return token;
+}
+
+bool QJsonRpcCancellationToken::isValid() const
+{
+    return m_state != nullptr;
+}
+
+bool QJsonRpcCancellationToken::isCancelled() const
+{
+    return m_state && m_state->cancelled.load(std::memory_order_acquire);
+}
+
+void QJsonRpcCancellationToken::cancel()
+{
+    if(!m_state)
+        return;
+
+    std::vector<Callback> callbacks;
+    {
+        QMutexLocker lock(&m_state->mutex);
+
+        if(m_state->cancelled.exchange(true, std::memory_order_acq_rel))
+            return;
+
+        callbacks.swap(m_state->callbacks);
+    }
+
+    //outside of the lock, callbacks may use the token
+    for(const auto& callback: callbacks)
+        callback();
+}
+
+void QJsonRpcCancellationToken::onCancelled(QJsonRpcCancellationToken::Callback &&callback)
+{
+    if(!m_state)
+        return;
+
+    {
+        QMutexLocker lock(&m_state->mutex);
+
+        if(!m_state->cancelled.load(std::memory_order_acquire))
+        {
+            m_state->callbacks.push_back(std::move(callback));
+            return;
+        }
+    }
+
+    callback();
+}
+
+bool QJsonRpcCancellationToken::operator==(const QJsonRpcCancellationToken &other) const
+{
+    return m_state == other.m_state;
+}
+
+
+
+QJsonRpcCallContext::QJsonRpcCallContext(const QJsonValue &id, const QDeadlineTimer &deadline, const Sink &sink)
+    : m_id{id}
+    , m_deadline{deadline}
+    , m_sink{sink}
+{
+
+}
+
+const QJsonValue &QJsonRpcCallContext::id() const
+{
+    return m_id;
+}
+
+const QDeadlineTimer &QJsonRpcCallContext::deadline() const
+{
+    return m_deadline;
+}
+
+bool QJsonRpcCallContext::isNotification() const
+{
+    return m_id.isUndefined();
+}
+
+void QJsonRpcCallContext::sendPartialResult(const QJsonValue &value) const
+{
+    //partial results of a notification have nowhere to go
+    if(isNotification())
+        return;
+
+    notify(QStringLiteral("$/partialResult"), QJsonObject{
+               {"id", m_id},
+               {"value", value}
+           });
+}
+
+void QJsonRpcCallContext::notify(const QString &method, const QJsonValue &params) const
+{
+    if(!m_sink)
+        return;
+
+    m_sink(QJsonDocument({
+                             {"jsonrpc", "2.0"},
+                             {"method", method},
+                             {"params", params}
+                         }));
+}
+
+bool QJsonRpcCallContext::canNotify() const
+{
+    return static_cast<bool>(m_sink);
+}
+
+quint64 QJsonRpcCallContext::peer() const
+{
+    return m_peer;
+}
+
+void QJsonRpcCallContext::setPeer(quint64 peer)
+{
+    m_peer = peer;
+}
+
+quint64 QJsonRpcCallContext::newPeer()
+{
+    static std::atomic<quint64> lastPeer {0};
+    return ++lastPeer;
+}
+
+bool QJsonRpcCallContext::isCancelled() const
+{
+    return m_token.isCancelled() || m_deadline.hasExpired();
+}
+
+QJsonRpcCancellationToken QJsonRpcCallContext::cancellationToken() const
+{
+    return m_token;
+}
+
+void QJsonRpcCallContext::setId(const QJsonValue &id)
+{
+    m_id = id;
+}
+
+void QJsonRpcCallContext::setDeadline(const QDeadlineTimer &deadline)
+{
+    m_deadline = deadline;
+}
+
+void QJsonRpcCallContext::setCancellationToken(const QJsonRpcCancellationToken &token)
+{
+    m_token = token;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <QJsonValue>
+#include <QJsonDocument>
+#include <QString>
+#include <QDeadlineTimer>
+#include <QMutex>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <vector>
+
+
+/*
+    Shared cancellation flag of one call.
+    Copies refer to the same state, a default constructed token is never cancelled.
+    Thread safe.
+*/
+class QJsonRpcCancellationToken
+{
+public:
+    using Callback = std::function<void()>;
+
+    QJsonRpcCancellationToken() = default;
+    static QJsonRpcCancellationToken create();
+
+    bool isValid() const;
+    bool isCancelled() const;
+    void cancel();
+
+    //Called once on cancel(), or right away if the token is cancelled already
+    void onCancelled(Callback&& callback);
+
+    bool operator==(const QJsonRpcCancellationToken& other) const;
+
+private:
+    struct State {
+        std::atomic<bool> cancelled {false};
+        std::vector<Callback> callbacks;
+        QMutex mutex;
+    };
+    std::shared_ptr<State> m_state;
+};
+
+
+/*
+    Passed to handlers registered with QJsonRpcServer::addMethodWithContext.
+    A call is cancelled when the client sent $/cancelRequest with its id
+    or when its deadline is over.
+    Notifications go to the sink given to QJsonRpcServer::execute,
+    without a sink they are dropped.
+*/
+class QJsonRpcCallContext
+{
+public:
+    using Sink = std::function<void(const QJsonDocument&)>;
+
+    QJsonRpcCallContext(const QJsonValue& id, const QDeadlineTimer& deadline, const Sink& sink = {});
+
+    const QJsonValue& id() const;
+    const QDeadlineTimer& deadline() const;
+    bool isNotification() const;
+
+    /*
+        Streaming results.
+        <-- {"jsonrpc": "2.0", "method": "$/partialResult", "params": {"id": <call id>, "value": value}}
+        The final response of the call follows all its partial results.
+    */
+    void sendPartialResult(const QJsonValue& value) const;
+    void notify(const QString& method, const QJsonValue& params) const;
+    bool canNotify() const;
+
+    //Connection the request came from, set by the transport. 0 - unknown
+    quint64 peer() const;
+    void setPeer(quint64 peer);
+    //Unique in the process, for a new connection. Begins with 1
+    static quint64 newPeer();
+
+    bool isCancelled() const;
+    QJsonRpcCancellationToken cancellationToken() const;
+
+    void setId(const QJsonValue& id);
+    void setDeadline(const QDeadlineTimer& deadline);
+    void setCancellationToken(const QJsonRpcCancellationToken& token);
+
+private:
+    QJsonValue m_id;
+    QDeadlineTimer m_deadline;
+    QJsonRpcCancellationToken m_token;
+    Sink m_sink;
+    quint64 m_peer {0};
+};
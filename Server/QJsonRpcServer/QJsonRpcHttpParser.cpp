@@ -0,0 +1,329 @@
+#include "QJsonRpcHttpParser.h"
+
+#include <cstring>
+
+//case insensitive compare of [begin, end) with a lower case literal
+static bool equalsLower(const char* begin, const char* end, const char* literal)
+{
+    const size_t size = std::strlen(literal);
+    if(static_cast<size_t>(end - begin) != size)
+        return false;
+
+    for(size_t i = 0; i < size; ++i)
+    {
+        char ch = begin[i];
+        if(ch >= 'A' && ch <= 'Z')
+            ch = static_cast<char>(ch - 'A' + 'a');
+        if(ch != literal[i])
+            return false;
+    }
+    return true;
+}
+
+//case insensitive search of a lower case literal in [begin, end)
+static bool containsLower(const char* begin, const char* end, const char* literal)
+{
+    const size_t size = std::strlen(literal);
+    for(const char* it = begin; static_cast<size_t>(end - it) >= size; ++it)
+        if(equalsLower(it, it + size, literal))
+            return true;
+    return false;
+}
+
+static const char* trimLeft(const char* begin, const char* end)
+{
+    while(begin < end && (*begin == ' ' || *begin == '\t'))
+        ++begin;
+    return begin;
+}
+
+static const char* trimRight(const char* begin, const char* end)
+{
+    while(end > begin && (end[-1] == ' ' || end[-1] == '\t'))
+        --end;
+    return end;
+}
+
+QJsonRpcHttpParser::QJsonRpcHttpParser(qint64 maxBodySize)
+    : m_maxBodySize{maxBodySize}
+{
+
+}
+
+void QJsonRpcHttpParser::append(const QByteArray &data)
+{
+    //drop consumed requests before the buffer grows
+    if(m_position > 0)
+    {
+        m_buffer.remove(0, static_cast<int>(m_position));
+        if(m_continued >= 0)
+            m_continued -= m_position;
+        m_position = 0;
+    }
+
+    m_buffer.append(data);
+}
+
+QJsonRpcHttpParser::Status QJsonRpcHttpParser::next(QJsonRpcHttpParser::Request &request)
+{
+    //empty lines between pipelined requests are allowed
+    while(m_buffer.size() - m_position >= 2 &&
+          m_buffer.at(static_cast<int>(m_position)) == '\r' &&
+          m_buffer.at(static_cast<int>(m_position) + 1) == '\n')
+        m_position += 2;
+
+    const int headersEnd = m_buffer.indexOf("\r\n\r\n", static_cast<int>(m_position));
+    if(headersEnd < 0)
+    {
+        if(m_buffer.size() - m_position > maxHeaderSize)
+            return Status::BadRequest;
+        return Status::Incomplete;
+    }
+
+    const char* data = m_buffer.constData();
+    const char* lineBegin = data + m_position;
+    const char* headersStop = data + headersEnd;
+
+    const char* lineEnd = static_cast<const char*>(std::memchr(lineBegin, '\r', static_cast<size_t>(headersStop - lineBegin)));
+    if(!lineEnd)
+        lineEnd = headersStop;
+
+    Request parsed;
+    bool isHttp10 {false};
+    if(!parseRequestLine(lineBegin, lineEnd, parsed, isHttp10))
+        return Status::BadRequest;
+
+    Headers headers;
+    headers.keepAlive = !isHttp10;
+    while(lineEnd < headersStop)
+    {
+        lineBegin = lineEnd + 2;
+        lineEnd = static_cast<const char*>(std::memchr(lineBegin, '\r', static_cast<size_t>(headersStop - lineBegin)));
+        if(!lineEnd)
+            lineEnd = headersStop;
+
+        if(!parseHeader(lineBegin, lineEnd, headers))
+            return Status::BadRequest;
+    }
+
+    //only chunked is decoded, and never along with a length
+    if(headers.transferEncoding && (!headers.chunked || headers.contentLength >= 0))
+        return Status::BadRequest;
+
+    const qint64 bodyBegin = headersEnd + 4;
+    qint64 requestEnd = bodyBegin;
+
+    if(headers.chunked)
+    {
+        requestEnd = parseChunkedBody(bodyBegin, parsed.body);
+        if(requestEnd == -1)
+        {
+            updateExpectContinue(headers);
+            return Status::Incomplete;
+        }
+        if(requestEnd == -2)
+            return Status::BadRequest;
+        if(requestEnd == -3)
+            return Status::PayloadTooLarge;
+    }
+    else if(headers.contentLength > 0)
+    {
+        if(headers.contentLength > m_maxBodySize)
+            return Status::PayloadTooLarge;
+
+        if(m_buffer.size() - bodyBegin < headers.contentLength)
+        {
+            updateExpectContinue(headers);
+            return Status::Incomplete;
+        }
+
+        parsed.body = m_buffer.mid(static_cast<int>(bodyBegin), static_cast<int>(headers.contentLength));
+        requestEnd = bodyBegin + headers.contentLength;
+    }
+
+    parsed.keepAlive = headers.keepAlive;
+    parsed.isHttp10 = isHttp10;
+    parsed.deflated = headers.deflated;
+    parsed.acceptsDeflate = headers.acceptsDeflate;
+    request = parsed;
+    m_position = requestEnd;
+    m_continued = -1;
+    m_expectContinue = false;
+    return Status::Complete;
+}
+
+qint64 QJsonRpcHttpParser::buffered() const
+{
+    return m_buffer.size() - m_position;
+}
+
+bool QJsonRpcHttpParser::takeExpectContinue()
+{
+    const bool expectContinue = m_expectContinue;
+    m_expectContinue = false;
+    return expectContinue;
+}
+
+void QJsonRpcHttpParser::updateExpectContinue(const QJsonRpcHttpParser::Headers &headers)
+{
+    //reported once, the headers of a pending request are parsed on every read
+    if(!headers.expectContinue || m_continued == m_position)
+        return;
+
+    m_continued = m_position;
+    m_expectContinue = true;
+}
+
+bool QJsonRpcHttpParser::parseRequestLine(const char *begin, const char *end, QJsonRpcHttpParser::Request &request, bool &isHttp10) const
+{
+    //METHOD SP target SP HTTP/1.x
+    const char* methodEnd = static_cast<const char*>(std::memchr(begin, ' ', static_cast<size_t>(end - begin)));
+    if(!methodEnd)
+        return false;
+
+    const char* targetBegin = methodEnd + 1;
+    const char* targetEnd = static_cast<const char*>(std::memchr(targetBegin, ' ', static_cast<size_t>(end - targetBegin)));
+    if(!targetEnd || targetEnd == targetBegin)
+        return false;
+
+    const char* version = targetEnd + 1;
+    if(end - version != 8 || std::memcmp(version, "HTTP/1.", 7) != 0)
+        return false;
+
+    if(version[7] == '0')
+        isHttp10 = true;
+    else if(version[7] != '1')
+        return false;
+
+    request.isPost = (methodEnd - begin == 4 && std::memcmp(begin, "POST", 4) == 0);
+    request.target = QByteArray(targetBegin, static_cast<int>(targetEnd - targetBegin));
+    return true;
+}
+
+bool QJsonRpcHttpParser::parseHeader(const char *begin, const char *end, QJsonRpcHttpParser::Headers &headers) const
+{
+    const char* colon = static_cast<const char*>(std::memchr(begin, ':', static_cast<size_t>(end - begin)));
+    if(!colon || colon == begin)
+        return false;
+
+    const char* valueBegin = trimLeft(colon + 1, end);
+    const char* valueEnd = trimRight(valueBegin, end);
+
+    if(equalsLower(begin, colon, "content-length"))
+    {
+        //also the same length twice
+        if(valueBegin == valueEnd || headers.contentLength >= 0)
+            return false;
+
+        qint64 length = 0;
+        for(const char* it = valueBegin; it < valueEnd; ++it)
+        {
+            if(*it < '0' || *it > '9')
+                return false;
+            length = length * 10 + (*it - '0');
+            if(length > (qint64(1) << 50))
+                return false;
+        }
+        headers.contentLength = length;
+    }
+    else if(equalsLower(begin, colon, "transfer-encoding"))
+    {
+        if(headers.transferEncoding)
+            return false;
+        headers.transferEncoding = true;
+        headers.chunked = equalsLower(valueBegin, valueEnd, "chunked");
+    }
+    else if(equalsLower(begin, colon, "content-encoding"))
+    {
+        //other codings can not be decoded
+        if(equalsLower(valueBegin, valueEnd, "deflate"))
+            headers.deflated = true;
+        else if(!equalsLower(valueBegin, valueEnd, "identity"))
+            return false;
+    }
+    else if(equalsLower(begin, colon, "accept-encoding"))
+    {
+        headers.acceptsDeflate = containsLower(valueBegin, valueEnd, "deflate");
+    }
+    else if(equalsLower(begin, colon, "expect"))
+    {
+        headers.expectContinue = equalsLower(valueBegin, valueEnd, "100-continue");
+    }
+    else if(equalsLower(begin, colon, "connection"))
+    {
+        if(containsLower(valueBegin, valueEnd, "close"))
+            headers.keepAlive = false;
+        else if(containsLower(valueBegin, valueEnd, "keep-alive"))
+            headers.keepAlive = true;
+    }
+
+    return true;
+}
+
+qint64 QJsonRpcHttpParser::parseChunkedBody(qint64 from, QByteArray &body) const
+{
+    const qint64 size = m_buffer.size();
+    const char* data = m_buffer.constData();
+    qint64 position = from;
+
+    while(true)
+    {
+        //chunk-size [; extensions] CRLF
+        const int lineEnd = m_buffer.indexOf("\r\n", static_cast<int>(position));
+        if(lineEnd < 0)
+            return -1;
+
+        qint64 chunkSize = 0;
+        qint64 digits = 0;
+        for(qint64 i = position; i < lineEnd; ++i, ++digits)
+        {
+            const char ch = data[i];
+            int value;
+            if(ch >= '0' && ch <= '9')
+                value = ch - '0';
+            else if(ch >= 'a' && ch <= 'f')
+                value = ch - 'a' + 10;
+            else if(ch >= 'A' && ch <= 'F')
+                value = ch - 'A' + 10;
+            else if(ch == ';' || ch == ' ')
+                break;
+            else
+                return -2;
+
+            chunkSize = chunkSize * 16 + value;
+            if(chunkSize > m_maxBodySize)
+                return -3;
+        }
+        if(digits == 0)
+            return -2;
+
+        position = lineEnd + 2;
+
+        if(chunkSize == 0)
+        {
+            //trailers up to the empty line
+            while(true)
+            {
+                const int trailerEnd = m_buffer.indexOf("\r\n", static_cast<int>(position));
+                if(trailerEnd < 0)
+                    return -1;
+                if(trailerEnd == position)
+                    return position + 2;
+                position = trailerEnd + 2;
+            }
+        }
+
+        if(body.size() + chunkSize > m_maxBodySize)
+            return -3;
+
+        if(size - position < chunkSize + 2)
+            return -1;
+
+        body.append(data + position, static_cast<int>(chunkSize));
+        position += chunkSize;
+
+        if(data[position] != '\r' || data[position + 1] != '\n')
+            return -2;
+        position += 2;
+    }
+}
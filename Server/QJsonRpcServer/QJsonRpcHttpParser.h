@@ -0,0 +1,71 @@
+#pragma once
+
+#include <QByteArray>
+
+
+/*
+    Incremental HTTP/1.1 request parser for the JSON-RPC endpoint.
+    Supports pipelined requests, Content-Length and chunked bodies, and
+    "deflate" as the only content coding. A request with Content-Length
+    more than once or together with Transfer-Encoding is a bad request,
+    two parsers could frame it differently.
+    Headers are parsed in place in the receive buffer, only the
+    request target and the body are copied out.
+*/
+class QJsonRpcHttpParser
+{
+public:
+    enum class Status {
+        Incomplete,
+        Complete,
+        BadRequest,
+        PayloadTooLarge
+    };
+
+    struct Request {
+        bool isPost {false};
+        bool keepAlive {true};
+        bool isHttp10 {false};
+        bool deflated {false};       //Content-Encoding: deflate
+        bool acceptsDeflate {false}; //Accept-Encoding lists deflate
+        QByteArray target;
+        QByteArray body;
+    };
+
+    explicit QJsonRpcHttpParser(qint64 maxBodySize = 64 * 1024 * 1024);
+
+    void append(const QByteArray& data);
+    //Takes the next complete request out of the buffer
+    Status next(Request& request);
+
+    qint64 buffered() const;
+
+    //True once per request whose headers came with "Expect: 100-continue"
+    //while its body is not complete, the client waits for "100 Continue"
+    bool takeExpectContinue();
+
+private:
+    struct Headers {
+        qint64 contentLength {-1};
+        bool transferEncoding {false};
+        bool chunked {false};
+        bool keepAlive {true};
+        bool expectContinue {false};
+        bool deflated {false};
+        bool acceptsDeflate {false};
+    };
+
+    void updateExpectContinue(const Headers& headers);
+    bool parseRequestLine(const char* begin, const char* end, Request& request, bool& isHttp10) const;
+    bool parseHeader(const char* begin, const char* end, Headers& headers) const;
+    //-1 - incomplete, -2 - bad, -3 - too large, otherwise offset after the body
+    qint64 parseChunkedBody(qint64 from, QByteArray& body) const;
+
+    static constexpr qint64 maxHeaderSize {64 * 1024};
+
+    qint64 m_maxBodySize;
+    QByteArray m_buffer;
+    qint64 m_position {0};
+    qint64 m_continued {-1}; //start of the request "100 Continue" was reported for
+    bool m_expectContinue {false};
+};
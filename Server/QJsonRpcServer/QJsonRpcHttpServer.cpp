@@ -0,0 +1,231 @@
+#include "QJsonRpcHttpServer.h"
+#include "QJsonRpcServer.h"
+#include "QJsonRpcRecorder.h"
+
+#include <QTcpSocket>
+#include <QtEndian>
+
+static const char plainMessageTag       = 'J';
+static const char compressedMessageTag  = 'Z';
+
+//executeMessage framing of a deflated body. qUncompress data is the zlib
+//stream after its big endian size, which only sizes the first buffer
+static QByteArray compressedMessage(const QByteArray& body)
+{
+    QByteArray message(5, compressedMessageTag);
+    qToBigEndian<quint32>(static_cast<quint32>(body.size()), message.data() + 1);
+    return message + body;
+}
+
+QJsonRpcHttpServer::QJsonRpcHttpServer(QJsonRpcServer &server, QObject *parent)
+    : QObject(parent)
+    , m_server{server}
+{
+    connect(&m_tcpServer, &QTcpServer::newConnection, this, &QJsonRpcHttpServer::onNewConnection);
+}
+
+bool QJsonRpcHttpServer::listen(const QHostAddress &address, quint16 port)
+{
+    return m_tcpServer.listen(address, port);
+}
+
+void QJsonRpcHttpServer::close()
+{
+    m_tcpServer.close();
+
+    const QList<QTcpSocket*> sockets = m_connections.keys();
+    for(QTcpSocket* socket: sockets)
+        socket->disconnectFromHost();
+}
+
+quint16 QJsonRpcHttpServer::serverPort() const
+{
+    return m_tcpServer.serverPort();
+}
+
+void QJsonRpcHttpServer::setMaxBodySize(qint64 bytes)
+{
+    m_maxBodySize = bytes;
+}
+
+void QJsonRpcHttpServer::setHighWatermark(qint64 bytes)
+{
+    m_highWatermark = bytes;
+}
+
+void QJsonRpcHttpServer::setRecorder(QJsonRpcRecorder *recorder)
+{
+    m_recorder = recorder;
+}
+
+int QJsonRpcHttpServer::connectionCount() const
+{
+    return m_connections.size();
+}
+
+void QJsonRpcHttpServer::onNewConnection()
+{
+    while(QTcpSocket* socket = m_tcpServer.nextPendingConnection())
+    {
+        m_connections.insert(socket, Connection{QJsonRpcHttpParser(m_maxBodySize), QJsonRpcCallContext::newPeer()});
+        socket->setReadBufferSize(readBufferSize);
+
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]{
+            onReadyRead(socket);
+        });
+        connect(socket, &QTcpSocket::bytesWritten, this, [this, socket]{
+            onBytesWritten(socket);
+        });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]{
+            m_connections.remove(socket);
+            m_paused.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void QJsonRpcHttpServer::onReadyRead(QTcpSocket *socket)
+{
+    //data stays in the socket until the responses are read
+    if(m_paused.contains(socket))
+        return;
+
+    while(true)
+    {
+        auto it = m_connections.find(socket);
+        if(it == m_connections.end())
+            return;
+
+        if(!processRequests(socket, it.value()))
+            return;
+
+        if(socket->bytesToWrite() >= m_highWatermark)
+        {
+            m_paused.insert(socket);
+            return;
+        }
+
+        const QByteArray data = socket->read(readChunkSize);
+        if(data.isEmpty())
+            return;
+        it.value().parser.append(data);
+    }
+}
+
+void QJsonRpcHttpServer::onBytesWritten(QTcpSocket *socket)
+{
+    if(!m_paused.contains(socket) || socket->bytesToWrite() > m_highWatermark / 4)
+        return;
+
+    m_paused.remove(socket);
+    onReadyRead(socket);
+}
+
+bool QJsonRpcHttpServer::processRequests(QTcpSocket *socket, Connection &connection)
+{
+    QJsonRpcHttpParser& parser = connection.parser;
+
+    //pipelined requests are answered in the order they came
+    QJsonRpcHttpParser::Request request;
+    while(true)
+    {
+        switch(parser.next(request))
+        {
+        case QJsonRpcHttpParser::Status::Incomplete:
+            if(parser.takeExpectContinue())
+                socket->write("HTTP/1.1 100 Continue\r\n\r\n");
+            return true;
+
+        case QJsonRpcHttpParser::Status::BadRequest:
+            writeError(socket, "400 Bad Request");
+            return false;
+
+        case QJsonRpcHttpParser::Status::PayloadTooLarge:
+            writeError(socket, "413 Payload Too Large");
+            return false;
+
+        case QJsonRpcHttpParser::Status::Complete:
+            break;
+        }
+
+        if(!request.isPost)
+        {
+            writeResponse(socket, "405 Method Not Allowed", QByteArray{}, request);
+        }
+        else
+        {
+            //a client accepting deflate is answered with the framing
+            QByteArray message;
+            if(request.deflated)
+                message = compressedMessage(request.body);
+            else if(request.acceptsDeflate)
+                message = plainMessageTag + request.body;
+            else
+                message = request.body;
+
+            QJsonRpcCallContext call(QJsonValue::Undefined, QDeadlineTimer(QDeadlineTimer::Forever));
+            call.setPeer(connection.peer);
+            const QByteArray response = m_server.executeMessage(message, call);
+
+            if(m_recorder)
+                m_recorder->record(message, response, QJsonRpcRecorder::Transport::Http, connection.peer);
+
+            //notification
+            if(response.isEmpty())
+                writeResponse(socket, "204 No Content", QByteArray{}, request);
+            else if(response.at(0) == compressedMessageTag) //without the size
+                writeResponse(socket, "200 OK", response.mid(5), request, true);
+            else if(response.at(0) == plainMessageTag)
+                writeResponse(socket, "200 OK", response.mid(1), request);
+            else
+                writeResponse(socket, "200 OK", response, request);
+        }
+
+        if(!request.keepAlive)
+            return false;
+
+        //the rest is answered when the client read these responses
+        if(socket->bytesToWrite() >= m_highWatermark)
+            return true;
+    }
+}
+
+void QJsonRpcHttpServer::writeResponse(QTcpSocket *socket, const char *status, const QByteArray &body,
+                                       const QJsonRpcHttpParser::Request &request, bool deflated)
+{
+    QByteArray head;
+    head.reserve(128);
+    head.append("HTTP/1.1 ");
+    head.append(status);
+    head.append("\r\nContent-Type: application/json\r\nContent-Length: ");
+    head.append(QByteArray::number(body.size()));
+    if(deflated)
+        head.append("\r\nContent-Encoding: deflate");
+    //an HTTP/1.0 client closes unless told otherwise
+    if(!request.keepAlive)
+        head.append("\r\nConnection: close");
+    else if(request.isHttp10)
+        head.append("\r\nConnection: keep-alive");
+    head.append("\r\n\r\n");
+
+    socket->write(head);
+    socket->write(body);
+
+    if(!request.keepAlive)
+        closeConnection(socket);
+}
+
+void QJsonRpcHttpServer::writeError(QTcpSocket *socket, const char *status)
+{
+    QJsonRpcHttpParser::Request closing;
+    closing.keepAlive = false;
+    writeResponse(socket, status, QByteArray{}, closing);
+}
+
+void QJsonRpcHttpServer::closeConnection(QTcpSocket *socket)
+{
+    //data still coming on the connection is not parsed anymore
+    m_connections.remove(socket);
+    m_paused.remove(socket);
+    socket->disconnectFromHost();
+}
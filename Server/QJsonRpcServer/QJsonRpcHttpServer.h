@@ -0,0 +1,81 @@
+#pragma once
+
+#include <QObject>
+#include <QTcpServer>
+#include <QHostAddress>
+#include <QHash>
+#include <QSet>
+#include "QJsonRpcHttpParser.h"
+
+class QJsonRpcServer;
+class QJsonRpcRecorder;
+class QTcpSocket;
+
+
+/*
+    Built-in HTTP/1.1 front end: POST bodies are passed to QJsonRpcServer::executeMessage.
+    --> POST / HTTP/1.1 {"jsonrpc": "2.0", "method": "subtract", "params": [42, 23], "id": 1}
+    <-- HTTP/1.1 200 OK {"jsonrpc":"2.0","id":1,"result":19}
+    Notifications are answered with 204 No Content. Every connection is a
+    peer of its calls; partial results can not be streamed in a response
+    and are dropped.
+    A body with "Content-Encoding: deflate" (zlib) is decompressed, and a
+    client sending "Accept-Encoding: deflate" gets responses over the
+    server's compressionThreshold deflated.
+    Connections are kept alive and pipelined requests are answered in order.
+    "Expect: 100-continue" is answered with "100 Continue" before the body
+    is read. A malformed request is answered with 400 and the connection
+    is closed, nothing after it is parsed.
+
+    Backpressure: while a client does not read its responses and they are
+    queued over the high watermark, its requests are not read. They wait in
+    the socket, whose read buffer is bounded, and reading continues below
+    a quarter of the high watermark.
+*/
+class QJsonRpcHttpServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit QJsonRpcHttpServer(QJsonRpcServer& server, QObject* parent = nullptr);
+
+    bool listen(const QHostAddress& address = QHostAddress::Any, quint16 port = 0);
+    void close();
+    quint16 serverPort() const;
+
+    void setMaxBodySize(qint64 bytes);
+    //Queued response bytes of a connection that stop reading its requests
+    void setHighWatermark(qint64 bytes);
+    //Every request body and its response (empty for notifications) are
+    //recorded, the recorder must outlive the server
+    void setRecorder(QJsonRpcRecorder* recorder);
+    int connectionCount() const;
+
+private:
+    void onNewConnection();
+    void onReadyRead(QTcpSocket* socket);
+    void onBytesWritten(QTcpSocket* socket);
+
+    struct Connection {
+        QJsonRpcHttpParser parser;
+        quint64 peer {0};
+    };
+    //Answers the requests complete in the parser. False if the connection
+    //was closed
+    bool processRequests(QTcpSocket* socket, Connection& connection);
+    void writeResponse(QTcpSocket* socket, const char* status, const QByteArray& body,
+                       const QJsonRpcHttpParser::Request& request, bool deflated = false);
+    //Answers a request that could not be parsed and closes the connection
+    void writeError(QTcpSocket* socket, const char* status);
+    void closeConnection(QTcpSocket* socket);
+
+    QJsonRpcServer& m_server;
+    QTcpServer m_tcpServer;
+    QHash<QTcpSocket*, Connection> m_connections;
+    QSet<QTcpSocket*> m_paused;
+    qint64 m_maxBodySize {64 * 1024 * 1024};
+    qint64 m_highWatermark {4 * 1024 * 1024};
+
+    static constexpr qint64 readBufferSize {1024 * 1024};
+    static constexpr qint64 readChunkSize {64 * 1024};
+    QJsonRpcRecorder* m_recorder {nullptr};
+};
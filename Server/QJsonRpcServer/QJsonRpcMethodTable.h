@@ -0,0 +1,228 @@
+#pragma once
+
+#include <QJsonValue>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QString>
+#include <array>
+#include <tuple>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <stdexcept>
+#include <limits>
+#include <cmath>
+
+
+/*
+    Compile-time method table for services with a fixed set of methods.
+
+    static int subtract(int subtrahend, int minuend);
+    static constexpr QJsonRpcMethodTable methods {
+        qJsonRpcMethod("subtract", &subtract, "subtrahend", "minuend"),
+        ...
+    };
+    server.addMethodTable(methods);
+
+    Names, parameter names and function pointers are constants and the argument
+    decoders are instantiated per parameter type. Inside a table dispatch is a
+    chain of name compares unrolled by the compiler, without a runtime
+    parameter name list. The server keeps every table behind one std::function
+    and tries the tables one after another.
+    Parameters that do not match the signature are answered with -32602,
+    numbers of integer parameters must be integral and in the range of the type.
+*/
+namespace QJsonRpcStatic
+{
+    //Params do not match the signature, answered with -32602.
+    //Exceptions of the handlers themselves are not mistaken for it
+    class DecodeError : public std::invalid_argument
+    {
+    public:
+        using std::invalid_argument::invalid_argument;
+    };
+
+    template<typename T>
+    struct Decoder;
+
+    template<>
+    struct Decoder<bool> {
+        static bool decode(const QJsonValue& value)
+        {
+            if(!value.isBool())
+                throw DecodeError("bool expected");
+            return value.toBool();
+        }
+    };
+
+    template<>
+    struct Decoder<int> {
+        static int decode(const QJsonValue& value)
+        {
+            if(!value.isDouble())
+                throw DecodeError("number expected");
+
+            const double number = value.toDouble();
+            if(std::floor(number) != number ||
+               number < std::numeric_limits<int>::min() || number > std::numeric_limits<int>::max())
+                throw DecodeError("int expected");
+            return static_cast<int>(number);
+        }
+    };
+
+    template<>
+    struct Decoder<qint64> {
+        static qint64 decode(const QJsonValue& value)
+        {
+            if(!value.isDouble())
+                throw DecodeError("number expected");
+
+            //2^63 is exact as double, the largest qint64 is not
+            const double number = value.toDouble();
+            if(std::floor(number) != number ||
+               number < -9223372036854775808.0 || number >= 9223372036854775808.0)
+                throw DecodeError("int64 expected");
+            return static_cast<qint64>(number);
+        }
+    };
+
+    template<>
+    struct Decoder<double> {
+        static double decode(const QJsonValue& value)
+        {
+            if(!value.isDouble())
+                throw DecodeError("number expected");
+            return value.toDouble();
+        }
+    };
+
+    template<>
+    struct Decoder<QString> {
+        static QString decode(const QJsonValue& value)
+        {
+            if(!value.isString())
+                throw DecodeError("string expected");
+            return value.toString();
+        }
+    };
+
+    template<>
+    struct Decoder<QJsonArray> {
+        static QJsonArray decode(const QJsonValue& value)
+        {
+            if(!value.isArray())
+                throw DecodeError("array expected");
+            return value.toArray();
+        }
+    };
+
+    template<>
+    struct Decoder<QJsonObject> {
+        static QJsonObject decode(const QJsonValue& value)
+        {
+            if(!value.isObject())
+                throw DecodeError("object expected");
+            return value.toObject();
+        }
+    };
+
+    template<>
+    struct Decoder<QJsonValue> {
+        static QJsonValue decode(const QJsonValue& value)
+        {
+            return value;
+        }
+    };
+
+    template<typename R, typename... Args>
+    struct Method {
+        std::string_view name;
+        std::array<std::string_view, sizeof...(Args)> params;
+        R (*function)(Args...);
+    };
+
+    template<typename R, typename... Args, size_t... I>
+    QJsonValue invoke(const Method<R, Args...>& method, const QJsonValue& params, std::index_sequence<I...>)
+    {
+        constexpr int count = static_cast<int>(sizeof...(Args));
+
+        //the same checks as for addMethod: all parameters, no extra ones
+        std::array<QJsonValue, sizeof...(Args)> args;
+        if(params.isArray())
+        {
+            const QJsonArray array = params.toArray();
+            if(array.size() != count)
+                throw DecodeError("wrong number of parameters");
+            ((args[I] = array.at(static_cast<int>(I))), ...);
+        }
+        else if(params.isObject())
+        {
+            const QJsonObject object = params.toObject();
+            if(object.size() != count)
+                throw DecodeError("wrong number of parameters");
+            ((args[I] = object.value(QLatin1String(method.params[I].data(),
+                                                   static_cast<int>(method.params[I].size())))), ...);
+            for(const QJsonValue& arg: args)
+                if(arg.isUndefined())
+                    throw DecodeError("unknown parameter");
+        }
+        else if(count != 0)
+        {
+            throw DecodeError("parameters expected");
+        }
+
+        if constexpr(std::is_void_v<R>)
+        {
+            method.function(Decoder<std::decay_t<Args>>::decode(args[I])...);
+            return QJsonValue::Null;
+        }
+        else
+        {
+            return QJsonValue(method.function(Decoder<std::decay_t<Args>>::decode(args[I])...));
+        }
+    }
+}
+
+
+template<typename R, typename... Args, typename... Names>
+constexpr QJsonRpcStatic::Method<R, Args...> qJsonRpcMethod(std::string_view name, R (*function)(Args...), Names... params)
+{
+    static_assert(sizeof...(Names) == sizeof...(Args), "every parameter needs a name");
+    return QJsonRpcStatic::Method<R, Args...>{name, {std::string_view(params)...}, function};
+}
+
+
+template<typename... Methods>
+class QJsonRpcMethodTable
+{
+public:
+    constexpr explicit QJsonRpcMethodTable(Methods... methods)
+        : m_methods{methods...}
+    {
+
+    }
+
+    constexpr bool contains(std::string_view name) const
+    {
+        return std::apply([&](const auto&... method){
+            return ((method.name == name) || ...);
+        }, m_methods);
+    }
+
+    //false when there is no such method, QJsonRpcStatic::DecodeError on bad params
+    bool dispatch(std::string_view name, const QJsonValue& params, QJsonValue& result) const
+    {
+        return std::apply([&](const auto&... method){
+            return ((method.name == name && (result = invokeMethod(method, params), true)) || ...);
+        }, m_methods);
+    }
+
+private:
+    template<typename R, typename... Args>
+    static QJsonValue invokeMethod(const QJsonRpcStatic::Method<R, Args...>& method, const QJsonValue& params)
+    {
+        return QJsonRpcStatic::invoke(method, params, std::index_sequence_for<Args...>{});
+    }
+
+    std::tuple<Methods...> m_methods;
+};
@@ -0,0 +1,116 @@
+#include "QJsonRpcParams.h"
+
+#include <QJsonDocument>
+
+QJsonRpcParams::QJsonRpcParams(const QJsonValue &params)
+    : m_params{params}
+{
+
+}
+
+QJsonRpcParams::QJsonRpcParams(QJsonValue &&params)
+    : m_params{std::move(params)}
+{
+
+}
+
+bool QJsonRpcParams::isEmpty() const
+{
+    return size() == 0;
+}
+
+bool QJsonRpcParams::isPositional() const
+{
+    return m_params.isArray();
+}
+
+bool QJsonRpcParams::isNamed() const
+{
+    return m_params.isObject();
+}
+
+int QJsonRpcParams::size() const
+{
+    if(m_params.isArray())
+        return m_params.toArray().size();
+    if(m_params.isObject())
+        return m_params.toObject().size();
+    return 0;
+}
+
+QJsonValue QJsonRpcParams::at(int index) const
+{
+    if(!m_params.isArray())
+        return QJsonValue::Undefined;
+
+    const QJsonArray params = m_params.toArray();
+    if(index < 0 || index >= params.size())
+        return QJsonValue::Undefined;
+
+    return params.at(index);
+}
+
+QJsonValue QJsonRpcParams::value(const QString &name) const
+{
+    if(!m_params.isObject())
+        return QJsonValue::Undefined;
+
+    return m_params.toObject().value(name);
+}
+
+QJsonValue QJsonRpcParams::value(QLatin1String name) const
+{
+    if(!m_params.isObject())
+        return QJsonValue::Undefined;
+
+    return m_params.toObject().value(name);
+}
+
+QVariant QJsonRpcParams::variant(int index) const
+{
+    return at(index).toVariant();
+}
+
+QVariant QJsonRpcParams::variant(const QString &name) const
+{
+    return value(name).toVariant();
+}
+
+QVariantList QJsonRpcParams::toVariantList() const
+{
+    if(!m_params.isArray())
+        return QVariantList{};
+
+    return m_params.toArray().toVariantList();
+}
+
+QJsonArray QJsonRpcParams::array() const
+{
+    return m_params.toArray();
+}
+
+QJsonObject QJsonRpcParams::object() const
+{
+    return m_params.toObject();
+}
+
+const QJsonValue &QJsonRpcParams::raw() const
+{
+    return m_params;
+}
+
+QByteArray QJsonRpcParams::toJson() const
+{
+    if(m_params.isArray())
+        return QJsonDocument(m_params.toArray()).toJson(QJsonDocument::Compact);
+    if(m_params.isObject())
+        return QJsonDocument(m_params.toObject()).toJson(QJsonDocument::Compact);
+    return QByteArray{};
+}
+
+QJsonValue QJsonRpcParams::take()
+{
+    QJsonValue params = std::move(m_params);
+    m_params = QJsonValue::Undefined;
+    return params;
+}
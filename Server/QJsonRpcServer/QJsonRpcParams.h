@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QJsonValue>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QVariant>
+#include <QVariantList>
+#include <QByteArray>
+#include <QString>
+
+
+/*
+    Lazy view over the "params" of a request, passed to handlers registered
+    with QJsonRpcServer::addMethodWithParams.
+    Nothing is converted up front: a field is decoded to QVariant only when
+    the handler asks for it, and proxy-style handlers can forward the raw
+    JSON value as it is.
+    The view shares the data of the parsed request (Qt implicit sharing),
+    array(), object() and raw() do not copy it, even for batch elements.
+    A handler that keeps the params beyond the call can take() them.
+*/
+class QJsonRpcParams
+{
+public:
+    //undefined (no params), array or object
+    explicit QJsonRpcParams(const QJsonValue& params = QJsonValue::Undefined);
+    explicit QJsonRpcParams(QJsonValue&& params);
+
+    bool isEmpty() const;
+    bool isPositional() const;
+    bool isNamed() const;
+    int size() const;
+
+    //Undefined when there is no such parameter
+    QJsonValue at(int index) const;
+    QJsonValue value(const QString& name) const;
+    QJsonValue value(QLatin1String name) const;
+
+    //On-demand conversion of a single parameter
+    QVariant variant(int index) const;
+    QVariant variant(const QString& name) const;
+
+    //Whole params as the other handlers get them, positional only
+    QVariantList toVariantList() const;
+
+    //Shared views, empty when the params are of the other kind
+    QJsonArray array() const;
+    QJsonObject object() const;
+
+    //Passthrough: the params as they came in, or as compact JSON text
+    const QJsonValue& raw() const;
+    QByteArray toJson() const;
+
+    //Moves the params out, the view is empty afterwards
+    QJsonValue take();
+
+private:
+    QJsonValue m_params;
+};
@@ -0,0 +1,312 @@
+#include "QJsonRpcPublisher.h"
+#include "QJsonRpcServer.h"
+
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QThread>
+#include <vector>
+#include <algorithm>
+
+QJsonRpcPublisher::SubscriberId QJsonRpcPublisher::addSubscriber(QJsonRpcPublisher::Writer &&writer,
+                                                                 const SubscriberOptions &options)
+{
+    //a subscriber id is the peer of the connection's calls
+    const SubscriberId id = QJsonRpcCallContext::newPeer();
+
+    QMutexLocker lock(&m_mutex);
+    m_subscribers.emplace(id, Subscriber{std::make_shared<const Writer>(std::move(writer)), options, {}, {}});
+    return id;
+}
+
+void QJsonRpcPublisher::removeSubscriber(QJsonRpcPublisher::SubscriberId id)
+{
+    QMutexLocker lock(&m_mutex);
+
+    //a writer may be running on another thread without the lock, its
+    //connection has to outlive it. The own thread is not waited for, a
+    //writer may remove its subscriber
+    const Qt::HANDLE self = QThread::currentThreadId();
+    for(auto it = m_writers.constFind(id); it != m_writers.constEnd() && it.value() != self; it = m_writers.constFind(id))
+        m_writersDone.wait(&m_mutex);
+
+    removeSubscriberImpl(id);
+}
+
+bool QJsonRpcPublisher::hasSubscriber(QJsonRpcPublisher::SubscriberId id) const
+{
+    QMutexLocker lock(&m_mutex);
+
+    return m_subscribers.find(id) != m_subscribers.end();
+}
+
+bool QJsonRpcPublisher::subscribe(QJsonRpcPublisher::SubscriberId id, const QString &topic)
+{
+    QMutexLocker lock(&m_mutex);
+
+    auto it = m_subscribers.find(id);
+    if(it == m_subscribers.end())
+        return false;
+
+    it->second.topics.insert(topic);
+    m_topics[topic].insert(id);
+    return true;
+}
+
+bool QJsonRpcPublisher::unsubscribe(QJsonRpcPublisher::SubscriberId id, const QString &topic)
+{
+    QMutexLocker lock(&m_mutex);
+
+    auto it = m_subscribers.find(id);
+    if(it == m_subscribers.end())
+        return false;
+
+    if(!it->second.topics.remove(topic))
+        return false;
+
+    auto topicIt = m_topics.find(topic);
+    if(topicIt != m_topics.end())
+    {
+        topicIt.value().remove(id);
+        if(topicIt.value().isEmpty())
+            m_topics.erase(topicIt);
+    }
+    return true;
+}
+
+int QJsonRpcPublisher::publish(const QString &topic, const QJsonValue &params)
+{
+    //subscribers written to directly, after the lock is released
+    std::vector<std::pair<SubscriberId, std::shared_ptr<const Writer>>> direct;
+    QByteArray message;
+    int receivers = 0;
+    {
+        QMutexLocker lock(&m_mutex);
+
+        ++m_stats.published;
+
+        auto topicIt = m_topics.constFind(topic);
+        if(topicIt == m_topics.constEnd())
+            return 0;
+
+        //serialised once for all subscribers
+        message = QJsonDocument({
+                                    {"jsonrpc", "2.0"},
+                                    {"method", topic},
+                                    {"params", params}
+                                }).toJson(QJsonDocument::Compact);
+
+        std::vector<SubscriberId> disconnected;
+        for(const SubscriberId id: topicIt.value())
+        {
+            auto it = m_subscribers.find(id);
+            if(it == m_subscribers.end())
+                continue;
+
+            //keep the order: nothing goes around the queue
+            Subscriber& subscriber = it->second;
+            if(subscriber.queue.empty() && !subscriber.writing)
+            {
+                subscriber.writing = true;
+                m_writers.insert(id, QThread::currentThreadId());
+                direct.emplace_back(id, subscriber.writer);
+                ++receivers;
+                continue;
+            }
+
+            switch(enqueue(subscriber, message))
+            {
+            case Delivery::Queued:
+                ++receivers;
+                break;
+            case Delivery::Dropped:
+                break;
+            case Delivery::Disconnect:
+                disconnected.push_back(id);
+                break;
+            }
+        }
+
+        for(const SubscriberId id: disconnected)
+        {
+            removeSubscriberImpl(id);
+            ++m_stats.disconnected;
+        }
+    }
+
+    for(const auto& subscriber: direct)
+        drain(subscriber.first, subscriber.second, std::deque<QByteArray>{message}, 1);
+
+    return receivers;
+}
+
+void QJsonRpcPublisher::flush(QJsonRpcPublisher::SubscriberId id)
+{
+    std::shared_ptr<const Writer> writer;
+    std::deque<QByteArray> messages;
+    {
+        QMutexLocker lock(&m_mutex);
+
+        auto it = m_subscribers.find(id);
+        if(it == m_subscribers.end())
+            return;
+
+        //the thread writing to it drains the queue itself
+        Subscriber& subscriber = it->second;
+        if(subscriber.writing || subscriber.queue.empty())
+            return;
+
+        subscriber.writing = true;
+        m_writers.insert(id, QThread::currentThreadId());
+        writer = subscriber.writer;
+        messages.swap(subscriber.queue);
+    }
+
+    drain(id, writer, std::move(messages), 0);
+}
+
+int QJsonRpcPublisher::queued(QJsonRpcPublisher::SubscriberId id) const
+{
+    QMutexLocker lock(&m_mutex);
+
+    auto it = m_subscribers.find(id);
+    if(it == m_subscribers.end())
+        return 0;
+
+    return static_cast<int>(it->second.queue.size());
+}
+
+QJsonRpcPublisher::Stats QJsonRpcPublisher::stats() const
+{
+    QMutexLocker lock(&m_mutex);
+
+    return m_stats;
+}
+
+void QJsonRpcPublisher::install(QJsonRpcServer &server)
+{
+    server.addMethodWithContext("rpc.subscribe", {"topic"},
+                                [this](const QVariantList& args, const QJsonRpcCallContext& ctx) -> QVariant {
+        return subscribe(ctx.peer(), args[0].toString());
+    });
+
+    server.addMethodWithContext("rpc.unsubscribe", {"topic"},
+                                [this](const QVariantList& args, const QJsonRpcCallContext& ctx) -> QVariant {
+        return unsubscribe(ctx.peer(), args[0].toString());
+    });
+}
+
+QJsonRpcPublisher::Delivery QJsonRpcPublisher::enqueue(QJsonRpcPublisher::Subscriber &subscriber, const QByteArray &message)
+{
+    if(!subscriber.queue.empty() && subscriber.queue.size() >= static_cast<size_t>(subscriber.options.maxQueued))
+    {
+        switch(subscriber.options.dropPolicy)
+        {
+        case DropPolicy::DropOldest:
+            subscriber.queue.pop_front();
+            ++m_stats.dropped;
+            break;
+        case DropPolicy::DropNewest:
+            ++m_stats.dropped;
+            return Delivery::Dropped;
+        case DropPolicy::Disconnect:
+            return Delivery::Disconnect;
+        }
+    }
+
+    subscriber.queue.push_back(message);
+    ++m_stats.queued;
+    return Delivery::Queued;
+}
+
+QJsonRpcPublisher::Delivery QJsonRpcPublisher::trim(QJsonRpcPublisher::Subscriber &subscriber)
+{
+    const size_t maxQueued = static_cast<size_t>(std::max(subscriber.options.maxQueued, 1));
+    if(subscriber.queue.size() <= maxQueued)
+        return Delivery::Queued;
+
+    const size_t excess = subscriber.queue.size() - maxQueued;
+    switch(subscriber.options.dropPolicy)
+    {
+    case DropPolicy::DropOldest:
+        subscriber.queue.erase(subscriber.queue.begin(), subscriber.queue.begin() + static_cast<std::ptrdiff_t>(excess));
+        break;
+    case DropPolicy::DropNewest:
+        subscriber.queue.erase(subscriber.queue.end() - static_cast<std::ptrdiff_t>(excess), subscriber.queue.end());
+        break;
+    case DropPolicy::Disconnect:
+        return Delivery::Disconnect;
+    }
+
+    m_stats.dropped += excess;
+    return Delivery::Dropped;
+}
+
+void QJsonRpcPublisher::drain(QJsonRpcPublisher::SubscriberId id, const std::shared_ptr<const Writer> &writer,
+                              std::deque<QByteArray> messages, size_t fresh)
+{
+    while(true)
+    {
+        size_t written = 0;
+        while(written < messages.size() && (*writer)(messages[written]))
+            ++written;
+
+        QMutexLocker lock(&m_mutex);
+
+        m_stats.delivered += written;
+        if(fresh > written)
+            m_stats.queued += fresh - written;
+        fresh = 0;
+
+        auto it = m_subscribers.find(id);
+        if(it == m_subscribers.end())
+        {
+            m_writers.remove(id);
+            m_writersDone.wakeAll();
+            return;
+        }
+
+        //refused messages go before the ones queued meanwhile
+        Subscriber& subscriber = it->second;
+        subscriber.queue.insert(subscriber.queue.begin(), messages.begin() + static_cast<std::ptrdiff_t>(written), messages.end());
+        if(trim(subscriber) == Delivery::Disconnect)
+        {
+            removeSubscriberImpl(id);
+            ++m_stats.disconnected;
+            m_writers.remove(id);
+            m_writersDone.wakeAll();
+            return;
+        }
+
+        if(written < messages.size() || subscriber.queue.empty())
+        {
+            subscriber.writing = false;
+            m_writers.remove(id);
+            m_writersDone.wakeAll();
+            return;
+        }
+
+        messages.clear();
+        messages.swap(subscriber.queue);
+    }
+}
+
+void QJsonRpcPublisher::removeSubscriberImpl(QJsonRpcPublisher::SubscriberId id)
+{
+    auto it = m_subscribers.find(id);
+    if(it == m_subscribers.end())
+        return;
+
+    for(const QString& topic: it->second.topics)
+    {
+        auto topicIt = m_topics.find(topic);
+        if(topicIt == m_topics.end())
+            continue;
+
+        topicIt.value().remove(id);
+        if(topicIt.value().isEmpty())
+            m_topics.erase(topicIt);
+    }
+
+    m_subscribers.erase(it);
+}
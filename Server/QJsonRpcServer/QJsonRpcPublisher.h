@@ -0,0 +1,116 @@
+#pragma once
+
+#include <QByteArray>
+#include <QJsonValue>
+#include <QString>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QWaitCondition>
+#include <functional>
+#include <deque>
+#include <memory>
+#include <map>
+
+class QJsonRpcServer;
+
+
+/*
+    Server-initiated notifications with topic subscriptions.
+
+    A published notification is serialised once,
+    <-- {"jsonrpc": "2.0", "method": <topic>, "params": params}
+    and the same implicitly shared QByteArray goes to every subscriber.
+
+    A subscriber is a writer of one connection. While the writer refuses
+    messages (its socket is over the high watermark) they are queued up to
+    maxQueued, then dropPolicy decides. flush() retries the queue when the
+    connection drained.
+
+    Writers are called without the publisher lock, so they may call back
+    into it. A subscriber's writer is not entered by two threads at once and
+    its messages keep the publish order. removeSubscriber() waits for a
+    writer running on another thread, after it returns the writer is not
+    called anymore and its connection may be destroyed.
+*/
+class QJsonRpcPublisher
+{
+public:
+    //Returns false if the message can not be written now
+    using Writer = std::function<bool(const QByteArray& message)>;
+    using SubscriberId = quint64;
+
+    enum class DropPolicy {
+        DropOldest,
+        DropNewest,
+        Disconnect
+    };
+
+    struct SubscriberOptions {
+        int maxQueued {256};
+        DropPolicy dropPolicy {DropPolicy::DropOldest};
+    };
+
+    struct Stats {
+        quint64 published {0};
+        quint64 delivered {0};
+        quint64 queued {0};
+        quint64 dropped {0};
+        quint64 disconnected {0};
+    };
+
+    SubscriberId addSubscriber(Writer&& writer, const SubscriberOptions& options = {});
+    void removeSubscriber(SubscriberId id);
+    bool hasSubscriber(SubscriberId id) const;
+
+    bool subscribe(SubscriberId id, const QString& topic);
+    bool unsubscribe(SubscriberId id, const QString& topic);
+
+    //Returns the count of subscribers the notification was written or queued for
+    int publish(const QString& topic, const QJsonValue& params);
+
+    void flush(SubscriberId id);
+    int queued(SubscriberId id) const;
+
+    Stats stats() const;
+
+    /*
+        Registers on the server, subscriber id is the peer of the call context:
+        --> {"jsonrpc": "2.0", "method": "rpc.subscribe", "params": {"topic": "news"}, "id": 1}
+        <-- {"jsonrpc": "2.0", "result": true, "id": 1}
+        and "rpc.unsubscribe" the same way.
+    */
+    void install(QJsonRpcServer& server);
+
+private:
+    struct Subscriber {
+        std::shared_ptr<const Writer> writer;
+        SubscriberOptions options;
+        std::deque<QByteArray> queue;
+        QSet<QString> topics;
+        bool writing {false}; //a thread calls the writer, others queue
+    };
+
+    enum class Delivery {
+        Queued,
+        Dropped,
+        Disconnect
+    };
+    Delivery enqueue(Subscriber& subscriber, const QByteArray& message);
+    //Applies the drop policy to a queue over maxQueued
+    Delivery trim(Subscriber& subscriber);
+    //Called for a subscriber marked as writing, without the lock. The first
+    //fresh messages were not counted as queued yet
+    void drain(SubscriberId id, const std::shared_ptr<const Writer>& writer,
+               std::deque<QByteArray> messages, size_t fresh);
+    void removeSubscriberImpl(SubscriberId id);
+
+    std::map<SubscriberId, Subscriber> m_subscribers;
+    //subscribers with a writer running and the thread running it
+    QHash<SubscriberId, Qt::HANDLE> m_writers;
+    QHash<QString, QSet<SubscriberId>> m_topics;
+    Stats m_stats;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_writersDone;
+};
@@ -0,0 +1,194 @@
+#include "QJsonRpcRecorder.h"
+#include "QJsonRpcServer.h"
+
+#include <QMutexLocker>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <stdexcept>
+
+QJsonRpcRecorder::QJsonRpcRecorder(QIODevice *log)
+    : m_stream{log}
+{
+    m_stream.setVersion(QDataStream::Qt_5_0);
+    m_stream << magic << version;
+}
+
+void QJsonRpcRecorder::record(const QByteArray &request, const QByteArray &response,
+                              Transport transport, quint64 connection)
+{
+    QMutexLocker lock(&m_mutex);
+
+    if(!m_clock.isValid())
+        m_clock.start();
+
+    m_stream << static_cast<qint64>(m_clock.nsecsElapsed()) << static_cast<quint8>(transport)
+             << connection << request << response;
+    ++m_count;
+}
+
+QByteArray QJsonRpcRecorder::execute(QJsonRpcServer &server, const QByteArray &message)
+{
+    const QByteArray response = server.executeMessage(message);
+    record(message, response);
+    return response;
+}
+
+int QJsonRpcRecorder::count() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_count;
+}
+
+std::vector<QJsonRpcRecorder::Record> QJsonRpcRecorder::read(QIODevice *log)
+{
+    QDataStream stream(log);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 logMagic {0};
+    quint32 logVersion {0};
+    stream >> logMagic >> logVersion;
+    if(logMagic != magic || logVersion < 1 || logVersion > version)
+        return {};
+
+    std::vector<Record> records;
+    while(!stream.atEnd())
+    {
+        Record record;
+        stream >> record.timestamp;
+        if(logVersion >= 2)
+        {
+            quint8 transport {0};
+            stream >> transport >> record.connection;
+            record.transport = static_cast<Transport>(transport);
+        }
+        stream >> record.request >> record.response;
+        if(stream.status() != QDataStream::Ok)
+            break;
+
+        records.push_back(std::move(record));
+    }
+
+    return records;
+}
+
+QByteArray QJsonRpcRecorder::toMessage(Transport transport, const QByteArray &message)
+{
+    //the other transports carry the executeMessage framing or plain JSON
+    if(transport == Transport::Line && message.startsWith('Z'))
+        return 'Z' + QByteArray::fromBase64(message.mid(1));
+    return message;
+}
+
+QByteArray QJsonRpcRecorder::toJson(const QByteArray &message)
+{
+    if(message.startsWith('Z'))
+        return qUncompress(message.mid(1));
+    if(message.startsWith('J'))
+        return message.mid(1);
+    return message;
+}
+
+//error object of a response or of any response of a batch
+static bool isError(const QByteArray& response)
+{
+    const QJsonDocument document = QJsonDocument::fromJson(QJsonRpcRecorder::toJson(response));
+    if(document.isObject())
+        return document.object().contains(QLatin1String("error"));
+    if(document.isArray())
+    {
+        for(const QJsonValue& value: document.array())
+            if(value.toObject().contains(QLatin1String("error")))
+                return true;
+        return false;
+    }
+    return true; //not JSON
+}
+
+QJsonRpcReplayer::Report QJsonRpcReplayer::replay(const std::vector<QJsonRpcRecorder::Record> &records,
+                                                  const Connect &connect, const Options &options)
+{
+    using Clock = std::chrono::steady_clock;
+
+    const int connections = std::max(1, options.connections);
+    const double speed = options.speed > 0 ? options.speed : 1.0;
+
+    std::vector<qint64> latencies(records.size(), 0);
+    std::atomic<size_t> next {0};
+    std::atomic<quint64> failures {0};
+
+    const Clock::time_point start = Clock::now();
+
+    auto worker = [&]{
+        //requests of a connection that could not be opened are failures
+        Target target;
+        try {
+            target = connect();
+        }
+        catch(...)
+        {
+        }
+
+        for(size_t i = next++; i < records.size(); i = next++)
+        {
+            const QJsonRpcRecorder::Record& record = records[i];
+
+            Clock::time_point due = Clock::now();
+            if(options.recordedRate)
+            {
+                due = start + std::chrono::nanoseconds(static_cast<qint64>(record.timestamp / speed));
+                std::this_thread::sleep_until(due);
+            }
+
+            try {
+                if(!target)
+                    throw std::runtime_error("not connected");
+                const bool expectsResponse = !record.response.isEmpty();
+                const QByteArray response = target(QJsonRpcRecorder::toMessage(record.transport, record.request),
+                                                   expectsResponse);
+                if(expectsResponse && isError(response))
+                    ++failures;
+            }
+            catch(...)
+            {
+                ++failures;
+            }
+
+            latencies[i] = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - due).count();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for(int i = 1; i < connections; ++i)
+        threads.emplace_back(worker);
+    worker();
+    for(auto& thread: threads)
+        thread.join();
+
+    Report report;
+    report.requests = records.size();
+    report.failures = failures;
+    report.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    if(report.seconds > 0)
+        report.throughput = report.requests / report.seconds;
+
+    if(latencies.empty())
+        return report;
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p){
+        const size_t index = static_cast<size_t>(p * (latencies.size() - 1));
+        return latencies[index];
+    };
+    report.p50 = percentile(0.5);
+    report.p90 = percentile(0.9);
+    report.p99 = percentile(0.99);
+    report.p999 = percentile(0.999);
+    report.max = latencies.back();
+
+    return report;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <functional>
+#include <vector>
+
+class QJsonRpcServer;
+
+
+/*
+    Captures JSON-RPC traffic into a binary log for QJsonRpcReplayer.
+    Log: "QJRL" + quint32 version, then per message
+         qint64 nanoseconds since the first message, quint8 transport,
+         quint64 connection, request, response
+    as QDataStream records. Messages are stored as they went over the wire,
+    a notification has an empty response. Version 1 logs, without the
+    transport and the connection, are read as Direct. Thread safe.
+*/
+class QJsonRpcRecorder
+{
+public:
+    //framing of the recorded messages
+    enum class Transport : quint8 {
+        Direct,         //QJsonRpcServer::executeMessage
+        Line,           //QJsonRpcSocketTransport line, 'Z' + base64
+        Http,           //body in the executeMessage framing
+        WebSocketText,  //plain JSON
+        WebSocketBinary //executeMessage framing
+    };
+
+    struct Record {
+        qint64 timestamp {0}; //nanoseconds since the first record
+        Transport transport {Transport::Direct};
+        quint64 connection {0}; //peer of the transport, 0 - none
+        QByteArray request;
+        QByteArray response;
+    };
+
+    //The log device must be open for writing and outlive the recorder
+    explicit QJsonRpcRecorder(QIODevice* log);
+
+    //For transports: called with every message and its response
+    void record(const QByteArray& request, const QByteArray& response,
+                Transport transport = Transport::Direct, quint64 connection = 0);
+    //QJsonRpcServer::executeMessage with recording
+    QByteArray execute(QJsonRpcServer& server, const QByteArray& message);
+
+    int count() const;
+
+    //Empty on a device that is not a log
+    static std::vector<Record> read(QIODevice* log);
+
+    //Recorded message in the executeMessage framing
+    static QByteArray toMessage(Transport transport, const QByteArray& message);
+    //JSON of a message in the executeMessage framing
+    static QByteArray toJson(const QByteArray& message);
+
+private:
+    static constexpr quint32 magic {0x514A524C}; //"QJRL"
+    static constexpr quint32 version {2};
+
+    mutable QMutex m_mutex;
+    QDataStream m_stream;
+    QElapsedTimer m_clock;
+    int m_count {0};
+};
+
+
+/*
+    Replays a recorded log against a server with a number of concurrent
+    connections, at the recorded rate (scaled by speed) or as fast as
+    possible, and reports throughput and latency percentiles.
+    At the recorded rate the latency is measured from the time the request
+    was due, so a stalled server is not hidden by the replay slowing down.
+*/
+class QJsonRpcReplayer
+{
+public:
+    //Sends a message in the QJsonRpcServer::executeMessage framing, whatever
+    //transport it was recorded on, and returns the response in the same
+    //framing. Waits for it only when one is expected
+    using Target = std::function<QByteArray(const QByteArray& message, bool expectsResponse)>;
+    //Opens one connection, called on the thread that will use it
+    using Connect = std::function<Target()>;
+
+    struct Options {
+        int connections {1};
+        bool recordedRate {true}; //false - as fast as possible
+        double speed {1.0};       //recorded rate multiplier
+    };
+
+    struct Report {
+        quint64 requests {0};
+        quint64 failures {0};  //target threw or answered with an error
+        double seconds {0};
+        double throughput {0}; //requests per second
+        //microseconds
+        qint64 p50 {0};
+        qint64 p90 {0};
+        qint64 p99 {0};
+        qint64 p999 {0};
+        qint64 max {0};
+    };
+
+    static Report replay(const std::vector<QJsonRpcRecorder::Record>& records,
+                         const Connect& connect, const Options& options = {});
+};
@@ -0,0 +1,104 @@
+#include "QJsonRpcResultCache.h"
+
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QMutexLocker>
+
+QJsonRpcResultCache::QJsonRpcResultCache(int capacity, int ttl)
+    : m_capacity{capacity > 0 ? capacity : 1}
+    , m_ttl{ttl}
+{
+
+}
+
+bool QJsonRpcResultCache::find(const QByteArray &key, QJsonValue &result)
+{
+    QMutexLocker lock(&m_mutex);
+
+    auto it = m_index.find(key);
+    if(it == m_index.end())
+    {
+        ++m_stats.misses;
+        return false;
+    }
+
+    Entries::iterator entry = it.value();
+    if(entry->expiry.hasExpired())
+    {
+        m_entries.erase(entry);
+        m_index.erase(it);
+        ++m_stats.expirations;
+        ++m_stats.misses;
+        return false;
+    }
+
+    //move to front
+    m_entries.splice(m_entries.begin(), m_entries, entry);
+
+    result = entry->value;
+    ++m_stats.hits;
+    return true;
+}
+
+void QJsonRpcResultCache::insert(const QByteArray &key, const QJsonValue &result)
+{
+    QMutexLocker lock(&m_mutex);
+
+    const QDeadlineTimer expiry = m_ttl > 0 ? QDeadlineTimer(m_ttl)
+                                            : QDeadlineTimer(QDeadlineTimer::Forever);
+
+    auto it = m_index.find(key);
+    if(it != m_index.end())
+    {
+        //same params were computed concurrently, refresh the entry
+        Entries::iterator entry = it.value();
+        entry->value = result;
+        entry->expiry = expiry;
+        m_entries.splice(m_entries.begin(), m_entries, entry);
+        return;
+    }
+
+    if(m_entries.size() >= static_cast<size_t>(m_capacity))
+    {
+        m_index.remove(m_entries.back().key);
+        m_entries.pop_back();
+        ++m_stats.evictions;
+    }
+
+    m_entries.push_front(Entry{key, result, expiry});
+    m_index.insert(key, m_entries.begin());
+}
+
+void QJsonRpcResultCache::clear()
+{
+    QMutexLocker lock(&m_mutex);
+
+    m_entries.clear();
+    m_index.clear();
+}
+
+int QJsonRpcResultCache::size() const
+{
+    QMutexLocker lock(&m_mutex);
+
+    return m_index.size();
+}
+
+QJsonRpcResultCache::Stats QJsonRpcResultCache::stats() const
+{
+    QMutexLocker lock(&m_mutex);
+
+    return m_stats;
+}
+
+QByteArray QJsonRpcResultCache::makeKey(const QJsonValue &params)
+{
+    //QJsonObject keeps keys sorted, so compact text is canonical
+    if(params.isArray())
+        return QJsonDocument(params.toArray()).toJson(QJsonDocument::Compact);
+    else if(params.isObject())
+        return QJsonDocument(params.toObject()).toJson(QJsonDocument::Compact);
+    else
+        return QByteArray{};
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <QByteArray>
+#include <QJsonValue>
+#include <QHash>
+#include <QMutex>
+#include <QDeadlineTimer>
+#include <list>
+
+
+/*
+    Bounded LRU cache of method results.
+    Key is the canonical (compact, sorted keys) JSON text of the parameters,
+    one cache is kept per cacheable method. Thread safe.
+*/
+class QJsonRpcResultCache
+{
+public:
+    struct Stats {
+        quint64 hits {0};
+        quint64 misses {0};
+        quint64 evictions {0};   //dropped because the cache was full
+        quint64 expirations {0}; //dropped because TTL is over
+    };
+
+    //ttl in milliseconds, 0 - entries never expire
+    QJsonRpcResultCache(int capacity, int ttl = 0);
+
+    bool find(const QByteArray& key, QJsonValue& result);
+    void insert(const QByteArray& key, const QJsonValue& result);
+    void clear();
+
+    int size() const;
+    Stats stats() const;
+
+    static QByteArray makeKey(const QJsonValue& params);
+
+private:
+    struct Entry {
+        QByteArray key;
+        QJsonValue value;
+        QDeadlineTimer expiry;
+    };
+    using Entries = std::list<Entry>;
+
+    const int m_capacity;
+    const int m_ttl;
+
+    Entries m_entries; //front is the most recently used
+    QHash<QByteArray, Entries::iterator> m_index;
+    Stats m_stats;
+
+    mutable QMutex m_mutex;
+};
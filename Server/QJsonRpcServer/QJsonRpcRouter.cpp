@@ -0,0 +1,320 @@
+#include "QJsonRpcRouter.h"
+#include "QJsonRpcServer.h"
+#include "QJsonRpcScanner.h"
+
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QHash>
+#include <QSemaphore>
+#include <algorithm>
+
+//Method of a single request taken from the raw message without parsing it.
+//False when the message has to be parsed: not an object, no method,
+//a method that is not a plain string or spelled with escapes
+static bool peekMethod(const QByteArray& message, std::string_view& method)
+{
+    const char* data = message.constData();
+    const int size = message.size();
+    int i = 0;
+
+    auto skipSpace = [&]{
+        while(i < size && (data[i] == ' ' || data[i] == '\t' || data[i] == '\n' || data[i] == '\r'))
+            ++i;
+    };
+
+    skipSpace();
+    if(i >= size || data[i] != '{')
+        return false;
+    ++i;
+
+    int depth = 1;
+    bool isKey = true; //next string at depth 1 is a key
+    while(i < size)
+    {
+        const char c = data[i];
+        if(c == '"')
+        {
+            //strings are skipped with the scanner, params may hold large ones
+            const int start = ++i;
+            while(true)
+            {
+                const qint64 quote = QJsonRpcScanner::indexOf(data + i, size - i, '"');
+                if(quote < 0)
+                    return false;
+                i += static_cast<int>(quote);
+
+                //escaped by an odd count of backslashes before it
+                int backslashes = 0;
+                while(i - backslashes > start && data[i - backslashes - 1] == '\\')
+                    ++backslashes;
+                if(backslashes % 2 == 0)
+                    break;
+                ++i;
+            }
+
+            //a key with escapes is never equal to the raw "method"
+            const std::string_view text(data + start, static_cast<size_t>(i - start));
+            ++i;
+
+            if(depth != 1 || !isKey)
+                continue;
+            isKey = false;
+            if(text != "method")
+                continue;
+
+            skipSpace();
+            if(i >= size || data[i] != ':')
+                return false;
+            ++i;
+            skipSpace();
+            if(i >= size || data[i] != '"')
+                return false;
+
+            const int valueStart = ++i;
+            while(i < size && data[i] != '"')
+            {
+                if(data[i] == '\\')
+                    return false;
+                ++i;
+            }
+            if(i >= size)
+                return false;
+
+            method = std::string_view(data + valueStart, static_cast<size_t>(i - valueStart));
+            return true;
+        }
+
+        if(c == '{' || c == '[')
+            ++depth;
+        else if(c == '}' || c == ']')
+        {
+            if(--depth == 0)
+                return false;
+        }
+        else if(c == ',' && depth == 1)
+            isKey = true;
+        ++i;
+    }
+    return false;
+}
+
+void QJsonRpcRouter::addRoute(const std::string &prefix, QJsonRpcRouter::Backend &&backend)
+{
+    const auto position = std::find_if(m_routes.begin(), m_routes.end(), [&](const Route& route){
+        return route.prefix.size() < prefix.size();
+    });
+    m_routes.insert(position, Route{prefix, std::move(backend)});
+}
+
+void QJsonRpcRouter::setMaxThreads(int threads)
+{
+    m_pool.setMaxThreadCount(threads);
+}
+
+bool QJsonRpcRouter::hasRoute(const QString &method) const
+{
+    return findRoute(QJsonValue(method)) != nullptr;
+}
+
+QByteArray QJsonRpcRouter::route(const QByteArray &message) const
+{
+    //passthrough, the message is neither parsed nor encoded again
+    std::string_view method;
+    if(peekMethod(message, method))
+    {
+        if(const Route* route = findRoute(method))
+        {
+            QByteArray response;
+            return send(*route, message, response) ? response : unavailable(message);
+        }
+    }
+
+    //errors, batches and unusual messages are parsed
+    const QJsonDocument request = QJsonDocument::fromJson(message);
+
+    if(request.isObject())
+    {
+        const QJsonObject obj = request.object();
+        const QJsonValue id = obj.value(QLatin1String("id"));
+
+        if(!obj.value(QLatin1String("method")).isString())
+            return QJsonDocument(error(-32600, "Invalid Request", QJsonValue::Null)).toJson(QJsonDocument::Compact);
+
+        const Route* route = findRoute(obj.value(QLatin1String("method")));
+        if(!route)
+        {
+            //notification
+            if(id.isUndefined())
+                return QByteArray{};
+            return QJsonDocument(error(-32601, "Method not found", id)).toJson(QJsonDocument::Compact);
+        }
+
+        QByteArray response;
+        return send(*route, message, response) ? response : unavailable(message);
+    }
+
+    if(request.isArray() && !request.array().isEmpty())
+        return routeBatch(message, request.array());
+
+    if(request.isArray())
+        return QJsonDocument(error(-32600, "Invalid Request", QJsonValue::Null)).toJson(QJsonDocument::Compact);
+
+    return QJsonDocument(error(-32700, "Parse error", QJsonValue::Null)).toJson(QJsonDocument::Compact);
+}
+
+const QJsonRpcRouter::Route *QJsonRpcRouter::findRoute(std::string_view method) const
+{
+    for(const Route& route: m_routes)
+    {
+        if(method.substr(0, route.prefix.size()) == route.prefix)
+            return &route;
+    }
+    return nullptr;
+}
+
+const QJsonRpcRouter::Route *QJsonRpcRouter::findRoute(const QJsonValue &method) const
+{
+    if(!method.isString())
+        return nullptr;
+
+    const QByteArray name = method.toString().toUtf8();
+    return findRoute(std::string_view(name.constData(), static_cast<size_t>(name.size())));
+}
+
+QByteArray QJsonRpcRouter::routeBatch(const QByteArray &message, const QJsonArray &batch) const
+{
+    //requests of every backend, in the order of the batch
+    std::vector<const Route*> destinations;
+    std::vector<QJsonArray> requests;
+    //answered here: invalid requests and unknown methods
+    QHash<int, QJsonObject> localResponses;
+
+    for(int i = 0; i < batch.size(); ++i)
+    {
+        const QJsonObject obj = batch.at(i).toObject();
+        const QJsonValue id = obj.value(QLatin1String("id"));
+
+        if(!batch.at(i).isObject() || !obj.value(QLatin1String("method")).isString())
+        {
+            localResponses.insert(i, error(-32600, "Invalid Request", QJsonValue::Null));
+            continue;
+        }
+
+        const Route* route = findRoute(obj.value(QLatin1String("method")));
+        if(!route)
+        {
+            if(!id.isUndefined())
+                localResponses.insert(i, error(-32601, "Method not found", id));
+            continue;
+        }
+
+        const auto destination = std::find(destinations.begin(), destinations.end(), route);
+        if(destination == destinations.end())
+        {
+            destinations.push_back(route);
+            requests.push_back(QJsonArray{obj});
+        }
+        else
+        {
+            requests[static_cast<size_t>(destination - destinations.begin())].append(obj);
+        }
+    }
+
+    std::vector<QByteArray> responses;
+    if(destinations.size() == 1 && localResponses.isEmpty())
+    {
+        //whole batch goes to one backend, passthrough
+        QByteArray response;
+        if(send(*destinations.front(), message, response))
+            return response;
+    }
+    else if(!destinations.empty())
+    {
+        //sub-batches go out at once, the first one from this thread
+        responses.resize(destinations.size());
+        QSemaphore done;
+        for(size_t i = 1; i < destinations.size(); ++i)
+        {
+            m_pool.start([&, i]{
+                send(*destinations[i], QJsonDocument(requests[i]).toJson(QJsonDocument::Compact), responses[i]);
+                done.release();
+            });
+        }
+        send(*destinations[0], QJsonDocument(requests[0]).toJson(QJsonDocument::Compact), responses[0]);
+        done.acquire(static_cast<int>(destinations.size()) - 1);
+    }
+
+    //backend responses by request id
+    QHash<QByteArray, QJsonValue> byId;
+    for(const QByteArray& response: responses)
+    {
+        const QJsonDocument document = QJsonDocument::fromJson(response);
+        const QJsonArray values = document.isArray() ? document.array()
+                                                     : QJsonArray{document.object()};
+        for(const QJsonValue& value: values)
+        {
+            const QByteArray key = QJsonRpcServer::idKey(value.toObject().value(QLatin1String("id")));
+            if(!key.isNull())
+                byId.insert(key, value);
+        }
+    }
+
+    QJsonArray result;
+    for(int i = 0; i < batch.size(); ++i)
+    {
+        const auto local = localResponses.constFind(i);
+        if(local != localResponses.constEnd())
+        {
+            result.append(local.value());
+            continue;
+        }
+
+        const QJsonValue id = batch.at(i).toObject().value(QLatin1String("id"));
+        const QByteArray key = QJsonRpcServer::idKey(id);
+        //notification or unknown method notification
+        if(key.isNull() || !findRoute(batch.at(i).toObject().value(QLatin1String("method"))))
+            continue;
+
+        const auto response = byId.constFind(key);
+        if(response != byId.constEnd())
+            result.append(response.value());
+        else
+            result.append(error(-32000, "Server error", id, "Backend unavailable"));
+    }
+
+    if(result.isEmpty())
+        return QByteArray{};
+
+    return QJsonDocument(result).toJson(QJsonDocument::Compact);
+}
+
+bool QJsonRpcRouter::send(const QJsonRpcRouter::Route &route, const QByteArray &message, QByteArray &response)
+{
+    try {
+        response = route.backend(message);
+        return true;
+    }
+    catch (const std::exception&) {
+        response.clear();
+        return false;
+    }
+}
+
+QByteArray QJsonRpcRouter::unavailable(const QByteArray &message)
+{
+    //parsed only on failure, a notification is not answered
+    const QJsonValue id = QJsonDocument::fromJson(message).object().value(QLatin1String("id"));
+    if(id.isUndefined())
+        return QByteArray{};
+
+    return QJsonDocument(error(-32000, "Server error", id, "Backend unavailable")).toJson(QJsonDocument::Compact);
+}
+
+QJsonObject QJsonRpcRouter::error(int code, const QString &message, const QJsonValue &id, const QJsonValue &data)
+{
+    QJsonObject error {{"code", code}, {"message", message}};
+    if(!data.isUndefined())
+        error.insert(QLatin1String("data"), data);
+
+    return QJsonObject{{"jsonrpc", "2.0"}, {"error", error}, {"id", id}};
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <QByteArray>
+#include <QJsonValue>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QString>
+#include <QThreadPool>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+/*
+    Forwards requests to backend services by method name prefix.
+    --> {"jsonrpc": "2.0", "method": "users.get", "params": [1], "id": 1}
+        is sent as it is to the backend added with prefix "users."
+    A single request and its response pass through as raw bytes: only the
+    method name is scanned out of the message, params and results are never
+    decoded. Batches for one backend pass through the same way, mixed ones
+    are split by backend and the responses are put back together in the
+    order of the requests.
+
+    A single request and a batch for one backend are sent on the thread
+    calling route(). The sub-batches of a mixed batch are sent at once, the
+    first one on the calling thread and the others on the router's thread
+    pool, so the batch takes as long as its slowest backend. Backends have
+    to allow calls from several threads at once, as route() does.
+
+    The router is a front end of its own, transports give it the raw
+    message. Methods served in this process are a backend like the remote
+    ones, through QJsonRpcServer::executeMessage:
+        router.addRoute("local.", [&server](const QByteArray& message){
+            return server.executeMessage(message);
+        });
+*/
+class QJsonRpcRouter
+{
+public:
+    //Sends one message (request or batch) and returns the response,
+    //empty when the message had only notifications
+    using Backend = std::function<QByteArray(const QByteArray& message)>;
+
+    //The longest matching prefix wins
+    void addRoute(const std::string& prefix, Backend&& backend);
+    bool hasRoute(const QString& method) const;
+
+    QByteArray route(const QByteArray& message) const;
+
+    //Threads sending sub-batches besides the calling one
+    void setMaxThreads(int threads);
+
+private:
+    struct Route {
+        std::string prefix;
+        Backend backend;
+    };
+
+    const Route* findRoute(std::string_view method) const;
+    const Route* findRoute(const QJsonValue& method) const;
+    QByteArray routeBatch(const QByteArray& message, const QJsonArray& batch) const;
+    //False if the backend threw, its requests get "Backend unavailable"
+    static bool send(const Route& route, const QByteArray& message, QByteArray& response);
+    static QByteArray unavailable(const QByteArray& message);
+
+    static QJsonObject error(int code, const QString& message, const QJsonValue& id,
+                             const QJsonValue& data = QJsonValue::Undefined);
+
+    std::vector<Route> m_routes; //longest prefix first
+    mutable QThreadPool m_pool;
+};
@@ -0,0 +1,12 @@
+#include "QJsonRpcScanner.h"
+
+#include <cstring>
+
+qint64 QJsonRpcScanner::indexOf(const char *data, qint64 size, char c)
+{
+    if(size <= 0)
+        return -1;
+
+    const void* found = std::memchr(data, c, static_cast<size_t>(size));
+    return found ? static_cast<const char*>(found) - data : -1;
+}
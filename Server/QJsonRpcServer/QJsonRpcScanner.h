@@ -0,0 +1,14 @@
+#pragma once
+
+#include <QtGlobal>
+
+
+/*
+    Byte scanning for message framing.
+    memchr of the C library is already vectorised on the common targets.
+*/
+namespace QJsonRpcScanner
+{
+    //Offset of the first c in [data, data + size) or -1
+    qint64 indexOf(const char* data, qint64 size, char c);
+}
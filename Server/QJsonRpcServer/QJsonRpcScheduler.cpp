@@ -0,0 +1,137 @@
+#include "QJsonRpcScheduler.h"
+
+#include <QMutexLocker>
+#include <algorithm>
+
+QJsonRpcScheduler::QJsonRpcScheduler(int slots)
+    : m_available{slots}
+{
+
+}
+
+QJsonRpcScheduler::Result QJsonRpcScheduler::acquire(int priority, const QDeadlineTimer &deadline, int timeout,
+                                                     const QJsonRpcCancellationToken &token)
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        if(tryAcquire())
+            return Result::Admitted;
+
+        if(timeout == 0)
+            return Result::Busy;
+    }
+
+    //wakes the waiters to look at their tokens. Registered without the lock,
+    //a cancelled token calls it right away
+    if(token.isValid())
+        token.onCancelled([this]{
+            QMutexLocker lock(&m_mutex);
+            m_condition.wakeAll();
+        });
+
+    QMutexLocker lock(&m_mutex);
+    if(tryAcquire())
+        return Result::Admitted;
+
+    if(token.isCancelled())
+        return Result::Cancelled;
+
+    if(deadline.hasExpired())
+        return Result::Expired;
+
+    Waiter waiter {priority, deadline.deadlineNSecs(), m_sequence++, false, false};
+    m_waiting.push_back(&waiter);
+
+    //until the timeout or the deadline, whichever is first
+    const QDeadlineTimer timer = timeout < 0 ? QDeadlineTimer(QDeadlineTimer::Forever)
+                                             : QDeadlineTimer(timeout);
+    const bool deadlineFirst = deadline.deadlineNSecs() < timer.deadlineNSecs();
+    const QDeadlineTimer wait = deadlineFirst ? deadline : timer;
+
+    while(!waiter.granted)
+    {
+        const bool woken = m_condition.wait(&m_mutex, wait);
+        if(waiter.granted)
+            break;
+
+        //removed by grant()
+        if(waiter.expired)
+            return Result::Expired;
+
+        if(token.isCancelled() || !woken)
+        {
+            m_waiting.erase(std::find(m_waiting.begin(), m_waiting.end(), &waiter));
+            if(token.isCancelled())
+                return Result::Cancelled;
+            return deadlineFirst ? Result::Expired : Result::Busy;
+        }
+    }
+    return Result::Admitted;
+}
+
+void QJsonRpcScheduler::release()
+{
+    QMutexLocker lock(&m_mutex);
+    ++m_available;
+    grant();
+}
+
+int QJsonRpcScheduler::available() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_available;
+}
+
+int QJsonRpcScheduler::waiting() const
+{
+    QMutexLocker lock(&m_mutex);
+    return static_cast<int>(m_waiting.size());
+}
+
+bool QJsonRpcScheduler::tryAcquire()
+{
+    //nobody to overtake
+    if(m_available <= 0 || !m_waiting.empty())
+        return false;
+
+    --m_available;
+    return true;
+}
+
+bool QJsonRpcScheduler::isBefore(const Waiter *left, const Waiter *right)
+{
+    if(left->priority != right->priority)
+        return left->priority > right->priority;
+    if(left->deadline != right->deadline)
+        return left->deadline < right->deadline;
+    return left->sequence < right->sequence;
+}
+
+void QJsonRpcScheduler::grant()
+{
+    if(m_available <= 0 || m_waiting.empty())
+        return;
+
+    //a slot is not given to a call that can only fail, it wakes up below
+    const qint64 now = QDeadlineTimer::current().deadlineNSecs();
+    const auto expired = std::stable_partition(m_waiting.begin(), m_waiting.end(), [now](const Waiter* waiter){
+        return waiter->deadline > now;
+    });
+    for(auto it = expired; it != m_waiting.end(); ++it)
+        (*it)->expired = true;
+    m_waiting.erase(expired, m_waiting.end());
+
+    if(m_waiting.empty())
+    {
+        m_condition.wakeAll();
+        return;
+    }
+
+    const auto next = std::min_element(m_waiting.begin(), m_waiting.end(), &QJsonRpcScheduler::isBefore);
+    (*next)->granted = true;
+    m_waiting.erase(next);
+    --m_available;
+
+    //waiters check their own flag
+    m_condition.wakeAll();
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <QDeadlineTimer>
+#include <QMutex>
+#include <QWaitCondition>
+#include <vector>
+#include "QJsonRpcCallContext.h"
+
+
+/*
+    Execution slots of a method or of the whole server.
+    A call that finds no free slot waits. A released slot goes to the waiting
+    call with the highest priority, among equal priorities to the one with
+    the earliest deadline, then to the one that came first. A waiting call
+    whose token is cancelled leaves right away, one whose deadline is over
+    leaves then and is skipped when a slot is released. Thread safe.
+*/
+class QJsonRpcScheduler
+{
+public:
+    enum class Result {
+        Admitted,
+        Busy,       //no slot within the timeout
+        Expired,    //no slot before the deadline
+        Cancelled
+    };
+
+    explicit QJsonRpcScheduler(int slots);
+
+    //timeout in ms, 0 - fail fast, negative - wait forever
+    Result acquire(int priority, const QDeadlineTimer& deadline, int timeout,
+                   const QJsonRpcCancellationToken& token = {});
+    void release();
+
+    int available() const;
+    int waiting() const;
+
+private:
+    struct Waiter {
+        int priority;
+        qint64 deadline;
+        quint64 sequence;
+        bool granted;
+        bool expired;
+    };
+
+    //Takes a free slot if no call waits for it, under the lock
+    bool tryAcquire();
+    static bool isBefore(const Waiter* left, const Waiter* right);
+    void grant();
+
+    int m_available;
+    quint64 m_sequence {0};
+    std::vector<Waiter*> m_waiting;
+    mutable QMutex m_mutex;
+    QWaitCondition m_condition;
+};
@@ -2,6 +2,13 @@
 
 
 #include <exception>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+#include <cstring>
+#include <QMutexLocker>
+#include <QtEndian>
 class ParseError : public std::exception
 {
     std::string what_message {"Json parse error"};
@@ -26,12 +33,214 @@ public:
 };
 
 
-QJsonRpcServer::Function::Function(QJsonRpcServer::Func &&func, QJsonRpcServer::Params &&params, bool variadic)
+//-32602, answered with the id of the request
+class InvalidParams : public std::exception
+{
+    std::string what_message {"Invalid params"};
+    // exception interface
+public:
+    virtual const char *what() const noexcept override
+    {
+        return what_message.c_str();
+    }
+};
+
+
+//-32000 "Server error", what() is sent as error data
+class ServerError : public std::exception
+{
+    std::string what_message;
+    // exception interface
+public:
+    explicit ServerError(const char* message)
+        : what_message{message}
+    {
+
+    }
+    virtual const char *what() const noexcept override
+    {
+        return what_message.c_str();
+    }
+};
+
+
+class ServerBusy : public ServerError
+{
+public:
+    ServerBusy() : ServerError("Server busy") {}
+};
+
+
+class DeadlineExceeded : public ServerError
+{
+public:
+    DeadlineExceeded() : ServerError("Deadline exceeded") {}
+};
+
+
+class RequestCancelled : public ServerError
+{
+public:
+    RequestCancelled() : ServerError("Request cancelled") {}
+};
+
+
+static const std::string_view cancelRequestMethod {"$/cancelRequest"};
+static const std::string_view discoverMethod {"rpc.discover"};
+
+
+//Bits of the JSON types accepted by a parameter
+enum JsonType : quint8 {
+    AnyType     = 0,
+    NullType    = 1 << 0,
+    BoolType    = 1 << 1,
+    IntegerType = 1 << 2,
+    NumberType  = 1 << 3,
+    StringType  = 1 << 4,
+    ArrayType   = 1 << 5,
+    ObjectType  = 1 << 6
+};
+
+static bool matchesType(const QJsonValue& value, quint8 types)
+{
+    if(types == AnyType)
+        return true;
+
+    switch(value.type())
+    {
+    case QJsonValue::Null:
+        return types & NullType;
+    case QJsonValue::Bool:
+        return types & BoolType;
+    case QJsonValue::Double:
+        if(types & NumberType)
+            return true;
+        return (types & IntegerType) && value.toDouble() == std::floor(value.toDouble());
+    case QJsonValue::String:
+        return types & StringType;
+    case QJsonValue::Array:
+        return types & ArrayType;
+    case QJsonValue::Object:
+        return types & ObjectType;
+    default:
+        return false;
+    }
+}
+
+
+//FNV-1a of the method name mixed with the seed of the perfect hash
+static quint64 methodHash(std::string_view name, quint32 seed)
+{
+    quint64 hash = 14695981039346656037ull ^ (seed * 0x9E3779B97F4A7C15ull);
+    for(const char c: name)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash ^ (hash >> 29);
+}
+
+
+//Holds one execution slot while the handler runs, waiting calls are
+//admitted by priority, then by deadline
+class Admission
+{
+    QJsonRpcScheduler* m_scheduler {nullptr};
+public:
+    Admission(QJsonRpcScheduler* scheduler, QJsonRpcMethodOptions::Priority priority,
+              const QDeadlineTimer& deadline, int timeout, const QJsonRpcCancellationToken& token = {})
+    {
+        if(!scheduler)
+            return;
+
+        switch(scheduler->acquire(static_cast<int>(priority), deadline, timeout, token))
+        {
+        case QJsonRpcScheduler::Result::Admitted:
+            break;
+        case QJsonRpcScheduler::Result::Busy:
+            throw ServerBusy();
+        case QJsonRpcScheduler::Result::Expired:
+            throw DeadlineExceeded();
+        case QJsonRpcScheduler::Result::Cancelled:
+            throw RequestCancelled();
+        }
+
+        m_scheduler = scheduler;
+    }
+    ~Admission()
+    {
+        if(m_scheduler)
+            m_scheduler->release();
+    }
+    Admission(const Admission&) = delete;
+    Admission& operator=(const Admission&) = delete;
+};
+
+//Keeps the token of a call findable by its peer and request id, from before
+//the call waits for a slot until it returns
+class CancellationScope
+{
+    QMultiHash<QByteArray, QJsonRpcCancellationToken>& m_tokens;
+    QMutex& m_mutex;
+    const QByteArray m_key;
+public:
+    const QJsonRpcCancellationToken token {QJsonRpcCancellationToken::create()};
+
+    CancellationScope(QMultiHash<QByteArray, QJsonRpcCancellationToken>& tokens, QMutex& mutex, const QByteArray& key)
+        : m_tokens{tokens}
+        , m_mutex{mutex}
+        , m_key{key}
+    {
+        if(m_key.isNull())
+            return;
+        QMutexLocker lock(&m_mutex);
+        m_tokens.insert(m_key, token);
+    }
+    ~CancellationScope()
+    {
+        if(m_key.isNull())
+            return;
+        QMutexLocker lock(&m_mutex);
+        m_tokens.remove(m_key, token);
+    }
+    CancellationScope(const CancellationScope&) = delete;
+    CancellationScope& operator=(const CancellationScope&) = delete;
+};
+
+
+QJsonRpcServer::Function::Function(QJsonRpcServer::Func &&func, QJsonRpcServer::Params &&params, bool variadic,
+                                   const MethodOptions &methodOptions)
     : f{func}
     , p{params}
     , isVariadic{variadic}
+    , options{methodOptions}
+{
+    if(options.cacheable)
+        cache = std::make_shared<QJsonRpcResultCache>(options.cacheSize, options.cacheTtl);
+
+    if(options.singleFlight)
+        flights = std::make_shared<QJsonRpcSingleFlight>();
+
+    if(options.maxConcurrency > 0)
+        executionSlots = std::make_shared<QJsonRpcScheduler>(options.maxConcurrency);
+
+    paramTypes = compileParamTypes(options.paramTypes);
+}
+
+QJsonRpcServer::Function::Function(QJsonRpcServer::ContextFunc &&func, QJsonRpcServer::Params &&params,
+                                   const MethodOptions &methodOptions)
+    : Function(Func{}, std::move(params), false, methodOptions)
 {
+    fc = std::move(func);
+    //the context is the caller's: deadline, cancellation, partial results
+    flights.reset();
+}
 
+QJsonRpcServer::Function::Function(QJsonRpcServer::ParamsFunc &&func, const MethodOptions &methodOptions)
+    : Function(Func{}, {}, true, methodOptions)
+{
+    fp = std::move(func);
+    flights.reset();
 }
 
 QJsonRpcServer::QJsonRpcServer()
@@ -39,21 +248,260 @@ QJsonRpcServer::QJsonRpcServer()
 
 }
 
-void QJsonRpcServer::addMethodVariadicParameters(const std::string &methodName, QJsonRpcServer::Func &&callback)
+void QJsonRpcServer::addMethodVariadicParameters(const std::string &methodName, QJsonRpcServer::Func &&callback,
+                                                 const MethodOptions &options)
+{
+    checkNotFrozen();
+
+    m_methods.insert(std::make_pair(methodName, Function(std::move(callback), {}, true, options)));
+
+    if(options.priority != MethodOptions::Priority::Normal)
+        m_hasPriorities = true;
+}
+
+void QJsonRpcServer::addMethod(const std::string &methodName, QJsonRpcServer::Params &paramNames, QJsonRpcServer::Func &&callback,
+                               const MethodOptions &options)
+{
+    checkNotFrozen();
+
+    m_methods.insert(std::make_pair(methodName, Function(std::move(callback), std::move(paramNames), false, options)));
+
+    if(options.priority != MethodOptions::Priority::Normal)
+        m_hasPriorities = true;
+}
+
+void QJsonRpcServer::addMethodWithContext(const std::string &methodName, QJsonRpcServer::Params &paramNames, QJsonRpcServer::ContextFunc &&callback,
+                                          const MethodOptions &options)
+{
+    checkNotFrozen();
+
+    m_methods.insert(std::make_pair(methodName, Function(std::move(callback), std::move(paramNames), options)));
+
+    if(options.priority != MethodOptions::Priority::Normal)
+        m_hasPriorities = true;
+}
+
+void QJsonRpcServer::addMethodWithParams(const std::string &methodName, QJsonRpcServer::ParamsFunc &&callback,
+                                         const MethodOptions &options)
+{
+    checkNotFrozen();
+
+    m_methods.insert(std::make_pair(methodName, Function(std::move(callback), options)));
+
+    if(options.priority != MethodOptions::Priority::Normal)
+        m_hasPriorities = true;
+}
+
+void QJsonRpcServer::mount(const std::string &prefix, QJsonRpcServer &server)
+{
+    checkNotFrozen();
+
+    //lookups and freeze() would recurse forever
+    if(server.mounts(*this))
+        throw std::logic_error("Mount would create a cycle of QJsonRpcServer mounts");
+
+    std::string name = prefix;
+    while(!name.empty() && name.back() == '.')
+        name.pop_back();
+
+    m_mounts[name] = &server;
+
+    //batches are sorted only by servers that have prioritised methods
+    if(server.m_hasPriorities)
+        m_hasPriorities = true;
+}
+
+void QJsonRpcServer::freeze()
+{
+    if(m_frozen)
+        return;
+
+    std::map<std::string, const Function*> methods;
+    collectMethods(std::string{}, methods);
+
+    const size_t count = methods.size();
+    const size_t bucketCount = count / 2 + 1;
+
+    //hash and displace: every bucket gets a seed that moves all its names
+    //into free slots, the biggest buckets are placed first
+    std::vector<std::vector<const std::pair<const std::string, const Function*>*>> buckets(bucketCount);
+    for(const auto& method: methods)
+        buckets[methodHash(method.first, 0) % bucketCount].push_back(&method);
+
+    std::vector<size_t> order(bucketCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t left, size_t right){
+        return buckets[left].size() > buckets[right].size();
+    });
+
+    std::vector<FrozenMethod> table(count);
+    std::string names;
+    std::vector<quint32> seeds(bucketCount, 0);
+    std::vector<size_t> slots;
+
+    for(const size_t bucket: order)
+    {
+        if(buckets[bucket].empty())
+            break;
+
+        for(quint32 seed = 1;; ++seed)
+        {
+            slots.clear();
+            for(const auto* method: buckets[bucket])
+            {
+                const size_t slot = methodHash(method->first, seed) % count;
+                if(table[slot].function || std::find(slots.begin(), slots.end(), slot) != slots.end())
+                    break;
+                slots.push_back(slot);
+            }
+
+            if(slots.size() != buckets[bucket].size())
+                continue;
+
+            for(size_t i = 0; i < slots.size(); ++i)
+            {
+                const std::string& name = buckets[bucket][i]->first;
+                FrozenMethod& record = table[slots[i]];
+                record.function = buckets[bucket][i]->second;
+                record.hash = static_cast<quint32>(methodHash(name, seed));
+                record.nameSize = static_cast<quint32>(name.size());
+                if(name.size() <= sizeof(record.inlineName))
+                {
+                    std::memcpy(record.inlineName, name.data(), name.size());
+                }
+                else
+                {
+                    record.nameOffset = static_cast<quint32>(names.size());
+                    names += name;
+                }
+            }
+            seeds[bucket] = seed;
+            break;
+        }
+    }
+
+    m_frozenMethods = std::move(table);
+    m_frozenSeeds = std::move(seeds);
+    m_frozenNames = std::move(names);
+    m_frozen = true;
+}
+
+QJsonObject QJsonRpcServer::discover() const
+{
+    std::map<std::string, const Function*> methods;
+    collectMethods(std::string{}, methods);
+
+    QJsonArray methodList;
+    for(const auto& method: methods)
+    {
+        const Function& function = *method.second;
+
+        QJsonArray params;
+        for(int i = 0; i < function.p.size(); ++i)
+        {
+            QJsonObject schema;
+            if(i < function.options.paramTypes.size() && !function.options.paramTypes.at(i).isEmpty())
+                schema.insert(QLatin1String("type"), function.options.paramTypes.at(i));
+
+            params.append(QJsonObject{
+                              {"name", function.p.at(i)},
+                              {"required", true},
+                              {"schema", schema}
+                          });
+        }
+
+        QJsonObject description {
+            {"name", QString::fromStdString(method.first)},
+            {"params", params},
+            {"result", QJsonObject{{"name", "result"}, {"schema", QJsonObject{}}}}
+        };
+        if(function.isVariadic)
+            description.insert(QLatin1String("paramStructure"), QLatin1String("by-position"));
+        if(!function.options.summary.isEmpty())
+            description.insert(QLatin1String("summary"), function.options.summary);
+
+        methodList.append(description);
+    }
+
+    return QJsonObject{
+        {"openrpc", "1.2.6"},
+        {"info", QJsonObject{{"title", "QJsonRpcServer"}, {"version", "1.0.0"}}},
+        {"methods", methodList}
+    };
+}
+
+bool QJsonRpcServer::isFrozen() const
 {
-    m_methods.insert(std::make_pair(methodName, Function(std::move(callback), {}, true)));
+    return m_frozen;
 }
 
-void QJsonRpcServer::addMethod(const std::string &methodName, QJsonRpcServer::Params &paramNames, QJsonRpcServer::Func &&callback)
+bool QJsonRpcServer::cancel(const QJsonValue &id, quint64 peer)
 {
-    m_methods.insert(std::make_pair(methodName, Function(std::move(callback), std::move(paramNames))));
+    const QByteArray key = cancellationKey(peer, id);
+    if(key.isNull())
+        return false;
+
+    QList<QJsonRpcCancellationToken> tokens;
+    {
+        QMutexLocker lock(&m_cancellableMutex);
+        tokens = m_cancellable.values(key);
+    }
+
+    for(auto& token: tokens)
+        token.cancel();
+
+    return !tokens.isEmpty();
+}
+
+QJsonRpcResultCache::Stats QJsonRpcServer::cacheStats(const std::string &methodName) const
+{
+    const Function* function = findFunction(methodName);
+    if(!function || !function->cache)
+        return QJsonRpcResultCache::Stats{};
+
+    return function->cache->stats();
+}
+
+int QJsonRpcServer::singleFlightWaiters(const std::string &methodName) const
+{
+    const Function* function = findFunction(methodName);
+    if(!function || !function->flights)
+        return 0;
+
+    return function->flights->waiters();
+}
+
+void QJsonRpcServer::clearCache()
+{
+    for(auto& method: m_methods)
+        if(method.second.cache)
+            method.second.cache->clear();
+
+    for(auto& mount: m_mounts)
+        mount.second->clearCache();
 }
 
 QJsonDocument QJsonRpcServer::execute(const QJsonDocument &request)
+{
+    return execute(request, QDeadlineTimer(QDeadlineTimer::Forever));
+}
+
+QJsonDocument QJsonRpcServer::execute(const QJsonDocument &request, const QDeadlineTimer &deadline)
+{
+    return execute(request, deadline, QJsonRpcCallContext::Sink{});
+}
+
+QJsonDocument QJsonRpcServer::execute(const QJsonDocument &request, const QDeadlineTimer &deadline,
+                                      const QJsonRpcCallContext::Sink &sink)
+{
+    return execute(request, QJsonRpcCallContext(QJsonValue::Undefined, deadline, sink));
+}
+
+QJsonDocument QJsonRpcServer::execute(const QJsonDocument &request, const QJsonRpcCallContext &call)
 {
     try {
         checkRequest(request);
-        return executeByType(request);
+        return executeByType(request, call);
     }
     catch(const ParseError& exc)
     {
@@ -99,6 +547,89 @@ QJsonDocument QJsonRpcServer::execute(const std::string &request)
     return execute(QJsonDocument::fromJson(request.c_str()));
 }
 
+static const char plainMessageTag       = 'J';
+static const char compressedMessageTag  = 'Z';
+
+QJsonRpcServer::LocalTransport QJsonRpcServer::localTransport(const QJsonRpcCallContext::Sink &sink)
+{
+    return [this, sink](const QJsonDocument& request){
+        return execute(request, QDeadlineTimer(QDeadlineTimer::Forever), sink);
+    };
+}
+
+QByteArray QJsonRpcServer::executeMessage(const QByteArray &message, const QJsonRpcCallContext::Sink &sink)
+{
+    return executeMessage(message, QJsonRpcCallContext(QJsonValue::Undefined,
+                                                       QDeadlineTimer(QDeadlineTimer::Forever), sink));
+}
+
+QByteArray QJsonRpcServer::executeMessage(const QByteArray &message, const QJsonRpcCallContext &call)
+{
+    const bool isFramed = !message.isEmpty() &&
+            (message.at(0) == plainMessageTag || message.at(0) == compressedMessageTag);
+
+    //legacy peer: plain JSON in, plain JSON out
+    if(!isFramed)
+    {
+        const QJsonDocument response = execute(QJsonDocument::fromJson(message), call);
+        if(response.isNull())
+            return QByteArray{};
+        return response.toJson(QJsonDocument::Compact);
+    }
+
+    QByteArray payload = message.mid(1);
+    if(message.at(0) == compressedMessageTag)
+    {
+        //qUncompress allocates the size in the header up front, so a large
+        //size is rejected before. Empty payload -> Parse error
+        const bool tooLarge = payload.size() < 4 ||
+                qFromBigEndian<quint32>(payload.constData()) > m_maxMessageSize;
+        payload = tooLarge ? QByteArray{} : qUncompress(payload);
+        if(payload.size() > m_maxMessageSize)
+            payload.clear();
+    }
+
+    const QJsonDocument response = execute(QJsonDocument::fromJson(payload), call);
+    if(response.isNull())
+        return QByteArray{};
+
+    const QByteArray json = response.toJson(QJsonDocument::Compact);
+    if(m_compressionThreshold > 0 && json.size() >= m_compressionThreshold)
+        return compressedMessageTag + qCompress(json);
+    else
+        return plainMessageTag + json;
+}
+
+void QJsonRpcServer::setMaxInFlight(int limit, int admissionTimeout)
+{
+    if(limit > 0)
+        m_inFlightSlots = std::make_unique<QJsonRpcScheduler>(limit);
+    else
+        m_inFlightSlots.reset();
+
+    m_inFlightTimeout = admissionTimeout;
+}
+
+void QJsonRpcServer::setCompressionThreshold(int bytes)
+{
+    m_compressionThreshold = bytes;
+}
+
+int QJsonRpcServer::compressionThreshold() const
+{
+    return m_compressionThreshold;
+}
+
+void QJsonRpcServer::setMaxMessageSize(qint64 bytes)
+{
+    m_maxMessageSize = bytes;
+}
+
+qint64 QJsonRpcServer::maxMessageSize() const
+{
+    return m_maxMessageSize;
+}
+
 
 void QJsonRpcServer::checkRequest(const QJsonDocument &request)
 {
@@ -109,15 +640,15 @@ void QJsonRpcServer::checkRequest(const QJsonDocument &request)
         throw InvalidRequest();
 }
 
-QJsonDocument QJsonRpcServer::executeByType(const QJsonDocument &request)
+QJsonDocument QJsonRpcServer::executeByType(const QJsonDocument &request, const QJsonRpcCallContext &call)
 {
     if(request.isArray())
     {
-        return executeArray(request.array());
+        return executeArray(request.array(), call);
     }
     else if(request.isObject())
     {
-        return executeObject(request.object());
+        return executeObject(request.object(), call);
     }
     else
     {
@@ -130,16 +661,35 @@ void QJsonRpcServer::chackArray(const QJsonArray &requestArray)
     if(requestArray.isEmpty())
         throw InvalidRequest();
 }
-QJsonDocument QJsonRpcServer::executeArray(const QJsonArray &requestArray)
+QJsonDocument QJsonRpcServer::executeArray(const QJsonArray &requestArray, const QJsonRpcCallContext &call)
 {
     chackArray(requestArray);
 
-    QJsonArray response;
+    //execution order: higher priority first, batch order otherwise
+    std::vector<int> order(static_cast<size_t>(requestArray.size()));
+    std::iota(order.begin(), order.end(), 0);
 
-    for(const auto& obj: requestArray)
+    if(m_hasPriorities)
     {
-        QJsonDocument result = executeObject(obj.toObject());
+        std::vector<MethodOptions::Priority> priorities;
+        priorities.reserve(order.size());
+        for(const auto& obj: requestArray)
+            priorities.push_back(priorityOf(obj));
+
+        std::stable_sort(order.begin(), order.end(), [&](int left, int right){
+            return priorities[left] > priorities[right];
+        });
+    }
+
+    std::vector<QJsonDocument> results(order.size());
+    //elements and their params share the data of the parsed batch
+    for(const int index: order)
+        results[index] = executeObject(requestArray.at(index).toObject(), call);
 
+    //responses keep the batch order
+    QJsonArray response;
+    for(const auto& result: results)
+    {
         //is not notification
         if(!result.isEmpty())
             response.append(result.object());
@@ -152,11 +702,66 @@ QJsonDocument QJsonRpcServer::executeArray(const QJsonArray &requestArray)
         return QJsonDocument{response};
 }
 
-QJsonDocument QJsonRpcServer::executeObject(const QJsonObject &obj)
+QJsonRpcServer::MethodOptions::Priority QJsonRpcServer::priorityOf(const QJsonValue &obj) const
+{
+    const QJsonValue method = obj.toObject().value(QLatin1String("method"));
+    if(!method.isString())
+        return MethodOptions::Priority::Normal;
+
+    const Function* currentFunc = findFunction(toMethodName(method.toString()));
+
+    if(!currentFunc)
+        return MethodOptions::Priority::Normal;
+
+    return currentFunc->options.priority;
+}
+
+QJsonDocument QJsonRpcServer::executeObject(const QJsonObject &obj, const QJsonRpcCallContext &call)
 {
     try {
         checkObject(obj);
-        return executeObjectImpl(obj);
+
+        //the caller gave up already, do not run it
+        if(call.deadline().hasExpired())
+            throw DeadlineExceeded();
+
+        QJsonRpcCallContext ctx = call;
+        ctx.setId(obj.value(QLatin1String("id")));
+        return executeObjectImpl(obj, ctx);
+    }
+    catch(const ServerError& exc)
+    {
+        qWarning() << exc.what();
+
+        //dropped notification
+        if(obj.value(QLatin1String("id")).isUndefined())
+            return QJsonDocument{};
+
+        return QJsonDocument({
+                                 {"jsonrpc", "2.0"},
+                                 {"error", QJsonObject{
+                                      {"code", -32000},
+                                      {"message", "Server error"},
+                                      {"data", exc.what()}
+                                  }},
+                                 {"id", obj.value(QLatin1String("id"))}
+                             });
+    }
+    catch(const InvalidParams& exc)
+    {
+        qWarning() << exc.what();
+
+        if(obj.value(QLatin1String("id")).isUndefined())
+            return QJsonDocument{};
+
+        return QJsonDocument({
+                                 {"jsonrpc", "2.0"},
+                                 {"error", QJsonObject{
+                                      {"code", -32602},
+                                      {"message", "Invalid params"}
+                                  }},
+                                 {"id", obj.value(QLatin1String("id"))}
+                             });
     }
     catch(const InvalidRequest& exc)
     {
@@ -186,36 +791,93 @@ QJsonDocument QJsonRpcServer::executeObject(const QJsonObject &obj)
 
 }
 
-QJsonDocument QJsonRpcServer::executeObjectImpl(const QJsonObject &obj)
+QJsonDocument QJsonRpcServer::executeObjectImpl(const QJsonObject &obj, const QJsonRpcCallContext &ctx)
 {
+    const std::string methodName = toMethodName(obj.value(QLatin1String("method")).toString());
+
+    if(methodName == cancelRequestMethod)
+        return executeCancelRequest(obj, ctx);
+
+    //registered rpc.discover wins over the built-in one
+    if(methodName == discoverMethod && !findFunction(methodName))
+    {
+        if(ctx.isNotification())
+            return QJsonDocument{};
+
+        return QJsonDocument{{{
+                    {"jsonrpc", "2.0"},
+                    {"result", discover()},
+                    {"id", ctx.id()}
+                }}};
+    }
+
     //Is notification?
-    if(obj.value("id").isUndefined())
-        return executeObjectNotification(obj);
+    if(ctx.isNotification())
+        return executeObjectNotification(obj, methodName, ctx);
     else
-        return executeObjectWithResult(obj);
+        return executeObjectWithResult(obj, methodName, ctx);
+}
+
+/*
+--> {"jsonrpc": "2.0", "method": "$/cancelRequest", "params": {"id": 1}}
+    or positional "params": [1]
+<-- Nothing, or {"jsonrpc": "2.0", "result": true, "id": ...} if it is not a notification
+*/
+QJsonDocument QJsonRpcServer::executeCancelRequest(const QJsonObject &obj, const QJsonRpcCallContext &ctx)
+{
+    const QJsonValue params = obj.value(QLatin1String("params"));
+
+    QJsonValue id;
+    if(params.isArray())
+        id = params.toArray().at(0);
+    else if(params.isObject())
+        id = params.toObject().value(QLatin1String("id"));
+
+    //ids are only unique per connection
+    const bool cancelled = cancel(id, ctx.peer());
+
+    if(obj.value(QLatin1String("id")).isUndefined())
+        return QJsonDocument{};
+
+    return QJsonDocument{{{
+                {"jsonrpc", "2.0"},
+                {"result", cancelled},
+                {"id", obj.value(QLatin1String("id"))}
+            }}};
 }
 
-QJsonDocument QJsonRpcServer::executeObjectNotification(const QJsonObject &obj)
+QJsonDocument QJsonRpcServer::executeObjectNotification(const QJsonObject &obj, std::string_view methodName, const QJsonRpcCallContext &ctx)
 {
-    const std::string methodName = obj.value("method").toString().toStdString();
+    const Function* currentFunc = findFunction(methodName);
 
-    if(!checkMethodExists(methodName))
+    if(!currentFunc)
+    {
+        QJsonValue result;
+        executeMethodTables(obj, methodName, ctx, result);
         //throw MethodNotFound without ID???
         return  QJsonDocument{};
+    }
 
 
-    Function currentFunc = getFunctionByName(methodName);
-    executeObjectByParametersType(obj, currentFunc);
+    executeObjectByParametersType(obj, *currentFunc, ctx);
 
     return QJsonDocument{};
 }
 
-QJsonDocument QJsonRpcServer::executeObjectWithResult(const QJsonObject &obj)
+QJsonDocument QJsonRpcServer::executeObjectWithResult(const QJsonObject &obj, std::string_view methodName, const QJsonRpcCallContext &ctx)
 {
-    QJsonValue request_id = obj.value("id");
-    const std::string methodName = obj.value("method").toString().toStdString();
+    QJsonValue request_id = ctx.id();
+    const Function* currentFunc = findFunction(methodName);
 
-    if(!checkMethodExists(methodName))
+    QJsonValue tableResult;
+    if(!currentFunc && executeMethodTables(obj, methodName, ctx, tableResult))
+        return QJsonDocument{{{
+                    {"jsonrpc", "2.0"},
+                    {"result", tableResult},
+                    {"id", request_id}
+                }}};
+
+    if(!currentFunc)
         //throw MethodNotFound with ID???
         return  QJsonDocument({{"jsonrpc", "2.0"},
                                {"error", QJsonObject{
@@ -225,58 +887,334 @@ QJsonDocument QJsonRpcServer::executeObjectWithResult(const QJsonObject &obj)
                                {"id", request_id}});
 
 
-    Function currentFunc = getFunctionByName(methodName);
-    QVariant result = executeObjectByParametersType(obj, currentFunc);
+    QJsonValue result = executeObjectShared(obj, *currentFunc, ctx);
 
     return QJsonDocument{{{
                 {"jsonrpc", "2.0"},
-                {"result", QJsonValue::fromVariant(result)},
+                {"result", result},
                 {"id", request_id}
             }}};
 }
 
-bool QJsonRpcServer::checkMethodExists(const std::string &methodName)
+bool QJsonRpcServer::executeMethodTables(const QJsonObject &obj, std::string_view methodName,
+                                         const QJsonRpcCallContext &ctx, QJsonValue &result)
+{
+    //unknown methods get "Method not found", not "Server busy"
+    std::string_view localName;
+    const MethodTable* table = findMethodTable(methodName, localName);
+    if(!table)
+        return false;
+
+    Admission server(m_inFlightSlots.get(), MethodOptions::Priority::Normal, ctx.deadline(), m_inFlightTimeout, ctx.cancellationToken());
+    const QJsonValue params = obj.value(QLatin1String("params"));
+
+    try {
+        return table->dispatch(localName, params, result);
+    }
+    catch(const QJsonRpcStatic::DecodeError&)
+    {
+        throw InvalidParams();
+    }
+}
+
+QJsonValue QJsonRpcServer::executeObjectShared(const QJsonObject &obj, const Function &currentFunc, const QJsonRpcCallContext &ctx)
+{
+    auto call = [&]{
+        return QJsonValue::fromVariant(executeObjectByParametersType(obj, currentFunc, ctx));
+    };
+
+    if(!currentFunc.cache && !currentFunc.flights)
+        return call();
+
+    //admission failures belong to the leader's call, they are not shared
+    auto shared = [&]{
+        try {
+            return call();
+        }
+        catch(const ServerBusy&)
+        {
+            throw QJsonRpcSingleFlight::Abandoned{std::current_exception()};
+        }
+        catch(const DeadlineExceeded&)
+        {
+            throw QJsonRpcSingleFlight::Abandoned{std::current_exception()};
+        }
+        catch(const RequestCancelled&)
+        {
+            throw QJsonRpcSingleFlight::Abandoned{std::current_exception()};
+        }
+    };
+
+    const QByteArray key = QJsonRpcResultCache::makeKey(obj.value("params"));
+
+    QJsonValue result;
+    if(currentFunc.cache && currentFunc.cache->find(key, result))
+        return result;
+
+    //handler exceptions are neither cached nor shared after the call is over
+    if(currentFunc.flights)
+    {
+        switch(currentFunc.flights->run(key, shared, result, ctx.deadline(), ctx.cancellationToken()))
+        {
+        case QJsonRpcSingleFlight::Result::Done:
+            break;
+        case QJsonRpcSingleFlight::Result::Expired:
+            throw DeadlineExceeded();
+        case QJsonRpcSingleFlight::Result::Cancelled:
+            throw RequestCancelled();
+        }
+    }
+    else
+        result = call();
+
+    if(currentFunc.cache)
+        currentFunc.cache->insert(key, result);
+    return result;
+}
+
+const QJsonRpcServer::Function* QJsonRpcServer::findFunction(std::string_view methodName) const
+{
+    if(m_frozen)
+        return findFrozenFunction(methodName);
+
+    auto it = m_methods.find(methodName);
+    if(it != m_methods.end())
+        return &it->second;
+
+    if(m_mounts.empty())
+        return nullptr;
+
+    //"a.b.op": sub-server "a.b" is tried first, then "a"
+    for(size_t dot = methodName.rfind('.'); dot != std::string_view::npos && dot > 0;
+        dot = methodName.rfind('.', dot - 1))
+    {
+        auto mount = m_mounts.find(methodName.substr(0, dot));
+        if(mount != m_mounts.end())
+        {
+            if(const Function* function = mount->second->findFunction(methodName.substr(dot + 1)))
+                return function;
+        }
+    }
+
+    return nullptr;
+}
+
+const QJsonRpcServer::MethodTable *QJsonRpcServer::findMethodTable(std::string_view methodName, std::string_view &localName) const
+{
+    for(const auto& table: m_methodTables)
+    {
+        if(table.contains(methodName))
+        {
+            localName = methodName;
+            return &table;
+        }
+    }
+
+    //same precedence as findFunction
+    for(size_t dot = methodName.rfind('.'); dot != std::string_view::npos && dot > 0;
+        dot = methodName.rfind('.', dot - 1))
+    {
+        auto mount = m_mounts.find(methodName.substr(0, dot));
+        if(mount != m_mounts.end())
+        {
+            if(const MethodTable* table = mount->second->findMethodTable(methodName.substr(dot + 1), localName))
+                return table;
+        }
+    }
+
+    return nullptr;
+}
+
+const QJsonRpcServer::Function *QJsonRpcServer::findFrozenFunction(std::string_view methodName) const
+{
+    if(m_frozenMethods.empty())
+        return nullptr;
+
+    const quint32 seed = m_frozenSeeds[methodHash(methodName, 0) % m_frozenSeeds.size()];
+    const quint64 hash = methodHash(methodName, seed);
+    const FrozenMethod& method = m_frozenMethods[hash % m_frozenMethods.size()];
+
+    //names that are not registered land on some slot too
+    if(!method.function || method.hash != static_cast<quint32>(hash) || method.nameSize != methodName.size())
+        return nullptr;
+
+    const char* name = method.nameSize <= sizeof(method.inlineName) ? method.inlineName
+                                                                    : m_frozenNames.data() + method.nameOffset;
+    if(std::memcmp(name, methodName.data(), methodName.size()) != 0)
+        return nullptr;
+
+    return method.function;
+}
+
+void QJsonRpcServer::collectMethods(const std::string &prefix, std::map<std::string, const Function *> &methods) const
+{
+    for(const auto& method: m_methods)
+        methods.emplace(prefix + method.first, &method.second);
+
+    //same precedence as findFunction: own methods, then deeper mounts
+    std::vector<const std::pair<const std::string, QJsonRpcServer*>*> mounts;
+    for(const auto& mount: m_mounts)
+        mounts.push_back(&mount);
+    std::stable_sort(mounts.begin(), mounts.end(), [](const auto* left, const auto* right){
+        return left->first.size() > right->first.size();
+    });
+
+    for(const auto* mount: mounts)
+        mount->second->collectMethods(prefix + mount->first + '.', methods);
+}
+
+bool QJsonRpcServer::mounts(const QJsonRpcServer &server) const
+{
+    if(this == &server)
+        return true;
+
+    for(const auto& mount: m_mounts)
+        if(mount.second->mounts(server))
+            return true;
+
+    return false;
+}
+
+void QJsonRpcServer::checkNotFrozen() const
 {
-    return m_methods.find(methodName) != m_methods.end();
+    if(m_frozen)
+        throw std::logic_error("Methods can not be added to a frozen QJsonRpcServer");
 }
 
-QJsonRpcServer::Function QJsonRpcServer::getFunctionByName(const std::string &methodName)
+std::string QJsonRpcServer::toMethodName(const QString &method)
 {
-    return m_methods.at(methodName);
+    //names up to the small string capacity do not allocate
+    std::string methodName;
+    methodName.reserve(static_cast<size_t>(method.size()));
+
+    //Method names are ASCII almost always, so skip the QByteArray of toUtf8()
+    for(const QChar ch: method)
+    {
+        if(ch.unicode() >= 0x80)
+        {
+            const QByteArray utf8 = method.toUtf8();
+            methodName.assign(utf8.constData(), static_cast<size_t>(utf8.size()));
+            return methodName;
+        }
+        methodName.push_back(static_cast<char>(ch.unicode()));
+    }
+
+    return methodName;
 }
 
-QVariant QJsonRpcServer::executeObjectByParametersType(const QJsonObject &obj, const Function& currentFunc)
+QVariant QJsonRpcServer::executeObjectByParametersType(const QJsonObject &obj, const Function& currentFunc, const QJsonRpcCallContext &ctx)
 {
-    QVariant result;
-    QJsonValue params = obj.value("params");
-    if(params.isUndefined()) //func(void)
+    //malformed calls do not take execution slots
+    checkParamCount(obj.value(QLatin1String("params")), currentFunc);
+    checkParamTypes(obj.value(QLatin1String("params")), currentFunc);
+
+    //handlers with a context can be cancelled, also while they wait for a slot
+    const bool hasContext = currentFunc.fc || currentFunc.fp;
+    CancellationScope cancellation(m_cancellable, m_cancellableMutex,
+                                   hasContext && !ctx.isNotification() ? cancellationKey(ctx.peer(), ctx.id()) : QByteArray{});
+
+    //a call waiting for its own method does not hold a server-wide slot
+    const MethodOptions::Priority priority = currentFunc.options.priority;
+    Admission method(currentFunc.executionSlots.get(), priority, ctx.deadline(),
+                     currentFunc.options.admissionTimeout, cancellation.token);
+    //control methods are not limited by the server-wide cap
+    const bool isControl = priority == MethodOptions::Priority::Control;
+    Admission server(isControl ? nullptr : m_inFlightSlots.get(), priority, ctx.deadline(),
+                     m_inFlightTimeout, cancellation.token);
+
+    if(cancellation.token.isCancelled())
+        throw RequestCancelled();
+
+    QVariantList args;
+    QJsonValue params = obj.value(QLatin1String("params"));
+    if(currentFunc.fp) //decoded by the handler itself
+    {
+        if(!params.isUndefined() && !params.isArray() && !params.isObject())
+            throw InvalidRequest();
+
+        //the handler may take() them, they are not used here anymore
+        QJsonRpcParams lazyParams(std::move(params));
+        return executeWithContext([&](const QJsonRpcCallContext& callContext){
+            return currentFunc.fp(std::move(lazyParams), callContext);
+        }, currentFunc, ctx, cancellation.token);
+    }
+    else if(params.isUndefined()) //func(void)
     {
-        result = currentFunc.f({});
     }
     else if(params.isArray()) //positional parameters
     {
-        result = currentFunc.f(params.toArray().toVariantList());
+        args = params.toArray().toVariantList();
     }
-    else if(params.isObject()) //named parameters
+    else if(params.isObject()) //named parameters, checked by checkParamCount
     {
-        checkMethodParameters(params.toObject(), currentFunc.p);
-        result = currentFunc.f(namesToParameterList(params.toObject(), currentFunc.p));
+        args = namesToParameterList(params.toObject(), currentFunc.p);
     }
     else {
         throw InvalidRequest();
     }
 
+    if(currentFunc.fc)
+        return executeWithContext([&](const QJsonRpcCallContext& callContext){
+            return currentFunc.fc(args, callContext);
+        }, currentFunc, ctx, cancellation.token);
+    else
+        return currentFunc.f(args);
+}
+
+QVariant QJsonRpcServer::executeWithContext(const std::function<QVariant(const QJsonRpcCallContext&)>& call,
+                                            const Function &currentFunc, const QJsonRpcCallContext &ctx,
+                                            const QJsonRpcCancellationToken &token)
+{
+    QJsonRpcCallContext callContext = ctx;
+
+    //per-call deadline is the earlier one of the request deadline and method timeout
+    if(currentFunc.options.timeout > 0)
+    {
+        const QDeadlineTimer timeout(currentFunc.options.timeout);
+        if(timeout < callContext.deadline())
+            callContext.setDeadline(timeout);
+    }
+
+    //registered by the caller before admission
+    callContext.setCancellationToken(token);
+
+    const QVariant result = call(callContext);
+
+    //the client does not wait for the result anymore
+    if(token.isCancelled())
+        throw RequestCancelled();
+
+    if(callContext.deadline().hasExpired())
+        throw DeadlineExceeded();
+
     return result;
 }
 
+QByteArray QJsonRpcServer::idKey(const QJsonValue &id)
+{
+    if(id.isString())
+        return 's' + id.toString().toUtf8();
+    else if(id.isDouble())
+        return 'n' + QByteArray::number(id.toDouble(), 'g', 17);
+    else
+        return QByteArray{};
+}
+
+QByteArray QJsonRpcServer::cancellationKey(quint64 peer, const QJsonValue &id)
+{
+    const QByteArray key = idKey(id);
+    if(key.isNull())
+        return key;
+
+    return QByteArray::number(peer) + ':' + key;
+}
+
 QVariantList QJsonRpcServer::namesToParameterList(const QJsonObject &objectParameters, const QJsonRpcServer::Params &methodParamNames)
 {
     QVariantList params;
+    params.reserve(methodParamNames.size());
     for(const auto& name: methodParamNames)
-    {
-        QVariant value = objectParameters.value(QString(name));
-        params.append(value);
-    }
+        params.append(QVariant(objectParameters.value(name)));
     return params;
 }
 
@@ -285,43 +1223,126 @@ void QJsonRpcServer::checkObject(const QJsonObject &obj)
     if(obj.empty())
         throw InvalidRequest();
 
-    if(obj.value("jsonrpc").toString() != QString("2.0"))
+    if(obj.value(QLatin1String("jsonrpc")).toString() != QLatin1String("2.0"))
         throw InvalidRequest();
 
-    if(obj.value("method").isUndefined())
+    const QJsonValue method = obj.value(QLatin1String("method"));
+    if(method.isUndefined())
         throw InvalidRequest();
 
-    if(!obj.value("method").isString())
+    if(!method.isString())
         throw InvalidRequest();
 
-    if(!obj.value("params").isUndefined())
+    const QJsonValue params = obj.value(QLatin1String("params"));
+    if(!params.isUndefined())
     {
-        if(!obj.value("params").isArray() && !obj.value("params").isObject())
+        if(!params.isArray() && !params.isObject())
             throw InvalidRequest();
     }
 
 
+    //has invalid elements
+    for(auto it = obj.begin(); it != obj.end(); ++it)
+    {
+        const QString key = it.key();
+        if(key != QLatin1String("jsonrpc") &&
+           key != QLatin1String("method") &&
+           key != QLatin1String("params") &&
+           key != QLatin1String("id"))
+            throw InvalidRequest();
+    }
 
-    static QSet<QString> validElements {
-        "jsonrpc", "method", "params", "id"
-    };
+}
 
-    QStringList localKeys = obj.keys();
-    QSet<QString> elements(localKeys.begin(), localKeys.end());
+std::vector<quint8> QJsonRpcServer::compileParamTypes(const QStringList &paramTypes)
+{
+    std::vector<quint8> types;
+    types.reserve(static_cast<size_t>(paramTypes.size()));
 
-    //has invalid elements
-    if(!elements.subtract(validElements).isEmpty())
-        throw InvalidRequest();
+    for(const auto& type: paramTypes)
+    {
+        if(type.isEmpty())
+            types.push_back(AnyType);
+        else if(type == QLatin1String("integer"))
+            types.push_back(IntegerType);
+        else if(type == QLatin1String("number"))
+            types.push_back(NumberType);
+        else if(type == QLatin1String("string"))
+            types.push_back(StringType);
+        else if(type == QLatin1String("boolean"))
+            types.push_back(BoolType);
+        else if(type == QLatin1String("array"))
+            types.push_back(ArrayType);
+        else if(type == QLatin1String("object"))
+            types.push_back(ObjectType);
+        else if(type == QLatin1String("null"))
+            types.push_back(NullType);
+        else
+            throw std::invalid_argument("Unknown parameter type " + type.toStdString());
+    }
+
+    return types;
+}
+
+void QJsonRpcServer::checkParamTypes(const QJsonValue &params, const Function &currentFunc)
+{
+    if(currentFunc.paramTypes.empty())
+        return;
 
+    if(params.isArray())
+    {
+        const QJsonArray array = params.toArray();
+        const int count = std::min(array.size(), static_cast<int>(currentFunc.paramTypes.size()));
+        for(int i = 0; i < count; ++i)
+            if(!matchesType(array.at(i), currentFunc.paramTypes[static_cast<size_t>(i)]))
+                throw InvalidParams();
+    }
+    else if(params.isObject())
+    {
+        const QJsonObject object = params.toObject();
+        const int count = std::min(currentFunc.p.size(), static_cast<int>(currentFunc.paramTypes.size()));
+        for(int i = 0; i < count; ++i)
+        {
+            const QJsonValue value = object.value(currentFunc.p.at(i));
+            if(!value.isUndefined() && !matchesType(value, currentFunc.paramTypes[static_cast<size_t>(i)]))
+                throw InvalidParams();
+        }
+    }
 }
 
 void QJsonRpcServer::checkMethodParameters(const QJsonObject &params, const QJsonRpcServer::Params &paramNames)
 {
-    QStringList keys = params.keys();
+    if(params.size() != paramNames.size())
+        throw InvalidParams();
 
-    QSet<QString> keys_set(keys.begin(), keys.end());
-    QSet<QString> params_set(paramNames.begin(), paramNames.end());
+    for(const auto& name: paramNames)
+        if(!params.contains(name))
+            throw InvalidParams();
+}
 
-    if(keys_set != params_set)
-        throw InvalidRequest();
+void QJsonRpcServer::checkParamCount(const QJsonValue &params, const Function &currentFunc)
+{
+    //handlers with the params view read the names they need themselves
+    if(currentFunc.fp)
+        return;
+
+    if(params.isObject())
+    {
+        checkMethodParameters(params.toObject(), currentFunc.p);
+        return;
+    }
+
+    //without names the arity is not known
+    if(currentFunc.isVariadic || currentFunc.p.isEmpty())
+        return;
+
+    if(params.isArray())
+    {
+        if(params.toArray().size() != currentFunc.p.size())
+            throw InvalidParams();
+    }
+    else if(params.isUndefined())
+    {
+        throw InvalidParams();
+    }
 }
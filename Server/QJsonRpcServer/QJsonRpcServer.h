@@ -4,25 +4,129 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <string>
+#include <string_view>
 #include <map>
+#include <vector>
 #include <functional>
 #include <QVariantList>
+#include <QByteArray>
+#include <QDeadlineTimer>
+#include <QMultiHash>
+#include <QMutex>
+#include <memory>
+#include "QJsonRpcResultCache.h"
+#include "QJsonRpcSingleFlight.h"
+#include "QJsonRpcScheduler.h"
+#include "QJsonRpcCallContext.h"
+#include "QJsonRpcParams.h"
+#include "QJsonRpcMethodTable.h"
 
 
+struct QJsonRpcMethodOptions
+{
+    //Pure method: results are cached by parameters and handler is skipped on hit
+    bool cacheable {false};
+    int cacheSize {1024};   //max cached results of the method
+    int cacheTtl {0};       //milliseconds, 0 - results never expire
+
+    //Concurrent calls with the same parameters share one handler execution,
+    //each waits for it until its own deadline. Ignored for handlers taking
+    //a call context, they run for every call
+    bool singleFlight {false};
+
+    //Max concurrent executions of the method, 0 - unlimited.
+    //Calls over the limit wait up to admissionTimeout milliseconds for a free
+    //slot (0 - fail fast) and then get -32000 "Server error" / "Server busy"
+    int maxConcurrency {0};
+    int admissionTimeout {0};
+
+    //Control methods (health checks etc.) run first in a batch and
+    //bypass the server-wide in-flight cap, Bulk methods run last.
+    //Calls waiting for a slot are admitted by priority, then by deadline
+    enum class Priority {
+        Bulk,
+        Normal,
+        Control
+    };
+    Priority priority {Priority::Normal};
+
+    //Per-call deadline in milliseconds seen by context handlers, 0 - none
+    int timeout {0};
+
+    //JSON schema types of the parameters in the order of the parameter names:
+    //"integer", "number", "string", "boolean", "array", "object", "null",
+    //empty - any. Parameters of other types are answered with -32602
+    //"Invalid params" before the handler runs. Published by rpc.discover
+    QStringList paramTypes;
+
+    //Free text for rpc.discover
+    QString summary;
+};
 
 
 class QJsonRpcServer
 {
     using Func = std::function<QVariant(const QVariantList&)>;
+    using ContextFunc = std::function<QVariant(const QVariantList&, const QJsonRpcCallContext&)>;
+    using ParamsFunc = std::function<QVariant(QJsonRpcParams, const QJsonRpcCallContext&)>;
     using Params = const QStringList;
+    using MethodOptions = QJsonRpcMethodOptions;
     struct Function {
         Func f;
+        ContextFunc fc; //set instead of f for context aware handlers
+        ParamsFunc fp;  //set instead of f for handlers reading params lazily
         Params p;
         bool isVariadic;
-        Function(Func&& func, Params&& params, bool variadic = false);
+        MethodOptions options;
+        std::shared_ptr<QJsonRpcResultCache> cache;
+        std::shared_ptr<QJsonRpcSingleFlight> flights;
+        std::shared_ptr<QJsonRpcScheduler> executionSlots;
+        std::vector<quint8> paramTypes; //compiled options.paramTypes, JsonType masks
+        Function(Func&& func, Params&& params, bool variadic = false,
+                 const MethodOptions& methodOptions = {});
+        Function(ContextFunc&& func, Params&& params,
+                 const MethodOptions& methodOptions = {});
+        Function(ParamsFunc&& func, const MethodOptions& methodOptions = {});
     };
 
-    std::map<std::string, Function> m_methods;
+    std::map<std::string, Function, std::less<>> m_methods;
+    //mounted sub-servers by namespace, without the trailing '.'
+    std::map<std::string, QJsonRpcServer*, std::less<>> m_mounts;
+
+    //minimal perfect hash over own and mounted methods, built by freeze().
+    //A record is half a cache line, short names are compared in it and
+    //longer ones after the hash matched. The handler stays in its
+    //std::map node, which never moves as methods are only inserted
+    struct alignas(32) FrozenMethod {
+        const Function* function {nullptr}; //null - free slot
+        quint32 hash {0};                   //low bits of the seeded hash of the name
+        quint32 nameSize {0};
+        quint32 nameOffset {0};             //in m_frozenNames
+        char inlineName[12] {};             //names up to 12 bytes
+    };
+    std::vector<FrozenMethod> m_frozenMethods; //indexed by the hash
+    std::vector<quint32> m_frozenSeeds;        //per bucket seed of the hash
+    std::string m_frozenNames;                 //pool of the names longer than inlineName
+    bool m_frozen {false};
+
+    //compile-time tables added with addMethodTable, tried after m_methods
+    struct MethodTable {
+        std::function<bool(std::string_view)> contains;
+        std::function<bool(std::string_view, const QJsonValue&, QJsonValue&)> dispatch;
+    };
+    std::vector<MethodTable> m_methodTables;
+
+    int m_compressionThreshold {0}; //0 - compression is disabled
+    qint64 m_maxMessageSize {64 * 1024 * 1024};
+
+    std::unique_ptr<QJsonRpcScheduler> m_inFlightSlots; //null - unlimited
+    int m_inFlightTimeout {0};
+
+    bool m_hasPriorities {false};
+
+    //running context handlers by request id
+    QMultiHash<QByteArray, QJsonRpcCancellationToken> m_cancellable;
+    QMutex m_cancellableMutex;
 
 
 public:
@@ -30,38 +134,179 @@ public:
     QJsonRpcServer();
 
     void addMethodVariadicParameters(const std::string& methodName,
-                   Func&& callback);
+                   Func&& callback,
+                   const MethodOptions& options = {});
 
     void addMethod(const std::string& methodName,
                    Params& paramNames,
-                   Func&& callback);
+                   Func&& callback,
+                   const MethodOptions& options = {});
+
+    //Handler gets the call context to watch for cancellation and deadline.
+    //A cancelled call is answered with -32000 "Server error" / "Request cancelled"
+    void addMethodWithContext(const std::string& methodName,
+                   Params& paramNames,
+                   ContextFunc&& callback,
+                   const MethodOptions& options = {});
+
+    //Handler gets the params undecoded and converts only what it uses,
+    //positional and named params are passed as they are. The view owns
+    //a shared reference to the request data and can be moved out of the call
+    void addMethodWithParams(const std::string& methodName,
+                   ParamsFunc&& callback,
+                   const MethodOptions& options = {});
+
+    //Methods of a QJsonRpcMethodTable, see QJsonRpcMethodTable.h.
+    //Parameters not matching the signature get -32602 "Invalid params".
+    //They run under the server-wide in-flight cap only, without method options.
+    //Tables of mounted sub-servers are served with the prefix as well
+    template<typename... Methods>
+    void addMethodTable(const QJsonRpcMethodTable<Methods...>& table)
+    {
+        checkNotFrozen();
+
+        m_methodTables.push_back(MethodTable{
+            [table](std::string_view methodName){
+                return table.contains(methodName);
+            },
+            [table](std::string_view methodName, const QJsonValue& params, QJsonValue& result){
+                return table.dispatch(methodName, params, result);
+            }
+        });
+    }
+
+    /*
+        Methods of the sub-server are served as "<prefix>.<method>".
+        Mounting does not copy the methods, the sub-server must outlive this
+        one and its methods run under the limits of this server.
+        Own methods win over mounted ones, deeper mounts win over shallower.
+        Mounting a server into itself, directly or through its own mounts,
+        throws std::logic_error.
+    */
+    void mount(const std::string& prefix, QJsonRpcServer& server);
+
+    /*
+        rpc.discover is answered with an OpenRPC style description of own
+        and mounted methods, their parameter names and types.
+        --> {"jsonrpc": "2.0", "method": "rpc.discover", "id": 1}
+        <-- {"jsonrpc": "2.0", "result": {"openrpc": "1.2.6", "info": {...}, "methods": [...]}, "id": 1}
+    */
+    QJsonObject discover() const;
+
+    /*
+        Compiles own and mounted methods into an immutable dispatch table.
+        Later lookups only use the table, so addMethod and mount after
+        freeze throw std::logic_error; methods added to a mounted server
+        after freeze are not visible.
+    */
+    void freeze();
+    bool isFrozen() const;
+
+    //Same as $/cancelRequest notification {"id": id} sent by the peer.
+    //Returns false if no cancellable call of the peer with the id is running
+    bool cancel(const QJsonValue& id, quint64 peer = 0);
+
+    //Empty stats for unknown or not cacheable methods
+    QJsonRpcResultCache::Stats cacheStats(const std::string& methodName) const;
+    void clearCache();
+
+    //Calls of a single flight method waiting for a running execution, 0 for other methods
+    int singleFlightWaiters(const std::string& methodName) const;
 
     QJsonDocument execute(const QJsonDocument& request);
     QJsonDocument execute(const std::string& request);
 
+    //Requests not started before the deadline are answered with
+    //-32000 "Server error" / "Deadline exceeded" without running the handler
+    QJsonDocument execute(const QJsonDocument& request, const QDeadlineTimer& deadline);
+
+    //Notifications sent by handlers while the request runs (partial results
+    //of streaming methods etc.) are passed to the sink before the response
+    QJsonDocument execute(const QJsonDocument& request, const QDeadlineTimer& deadline,
+                          const QJsonRpcCallContext::Sink& sink);
+
+    //Deadline, sink and peer of the request are taken from the call context
+    QJsonDocument execute(const QJsonDocument& request, const QJsonRpcCallContext& call);
+
+    /*
+        In-process channel for QJsonRpcClient::setTransport: requests and
+        responses are passed as documents, notifications of handlers go to
+        the sink. Partial results reach the client when the sink hands them
+        to it, before the response of the call:
+        client.setTransport(server.localTransport([&client](const QJsonDocument& message){
+            client.handlePartialResult(message);
+        }));
+    */
+    using LocalTransport = std::function<QJsonDocument(const QJsonDocument&)>;
+    LocalTransport localTransport(const QJsonRpcCallContext::Sink& sink = {});
+
+    /*
+        Wire level entry point for transports.
+        Plain JSON text is answered with plain compact JSON text.
+        A peer that prefixes its messages with 'J' (plain) or 'Z' (qCompress)
+        announces compression support and is answered with the same framing;
+        responses of at least compressionThreshold bytes are compressed.
+        Notifications produce an empty QByteArray.
+    */
+    QByteArray executeMessage(const QByteArray& message,
+                              const QJsonRpcCallContext::Sink& sink = {});
+    QByteArray executeMessage(const QByteArray& message, const QJsonRpcCallContext& call);
+
+    void setCompressionThreshold(int bytes);
+    int compressionThreshold() const;
+    //Largest decompressed 'Z' message, a bigger one is a parse error
+    void setMaxMessageSize(qint64 bytes);
+    qint64 maxMessageSize() const;
+
+    //Cap of handlers executing at once over all methods, 0 - unlimited.
+    //Must be set before the server starts serving requests
+    void setMaxInFlight(int limit, int admissionTimeout = 0);
+
+    //Hash key of a request id, 1 and "1" differ. Null for a missing or null id
+    static QByteArray idKey(const QJsonValue& id);
+
 private:
 
     void chackArray(const QJsonArray& requestArray);
     void checkRequest(const QJsonDocument &request);
-    QJsonDocument executeByType(const QJsonDocument &request);
+    QJsonDocument executeByType(const QJsonDocument &request, const QJsonRpcCallContext& call);
 
-    QJsonDocument executeArray(const QJsonArray& requestArray);
-    QJsonDocument executeObject(const QJsonObject& obj);
-    QJsonDocument executeObjectImpl(const QJsonObject& obj);
+    QJsonDocument executeArray(const QJsonArray& requestArray, const QJsonRpcCallContext& call);
+    QJsonDocument executeObject(const QJsonObject& obj, const QJsonRpcCallContext& call);
+    MethodOptions::Priority priorityOf(const QJsonValue& obj) const;
+    QJsonDocument executeObjectImpl(const QJsonObject& obj, const QJsonRpcCallContext& ctx);
 
-    QJsonDocument executeObjectNotification(const QJsonObject& obj);
-    QJsonDocument executeObjectWithResult(const QJsonObject& obj);
+    QJsonDocument executeObjectNotification(const QJsonObject& obj, std::string_view methodName, const QJsonRpcCallContext& ctx);
+    QJsonDocument executeObjectWithResult(const QJsonObject& obj, std::string_view methodName, const QJsonRpcCallContext& ctx);
+    QJsonDocument executeCancelRequest(const QJsonObject& obj, const QJsonRpcCallContext& ctx);
+    static QByteArray cancellationKey(quint64 peer, const QJsonValue& id);
+    bool executeMethodTables(const QJsonObject& obj, std::string_view methodName,
+                             const QJsonRpcCallContext& ctx, QJsonValue& result);
 
 
-    bool checkMethodExists(const std::string& methodName);
-    Function getFunctionByName(const std::string& methodName);
-    QVariant executeObjectByParametersType(const QJsonObject& obj, const Function& currentFunc);
+    const Function* findFunction(std::string_view methodName) const;
+    //localName is methodName without the prefix of the mount owning the table
+    const MethodTable* findMethodTable(std::string_view methodName, std::string_view& localName) const;
+    const Function* findFrozenFunction(std::string_view methodName) const;
+    void collectMethods(const std::string& prefix, std::map<std::string, const Function*>& methods) const;
+    //this server is the given one or mounts it, directly or deeper
+    bool mounts(const QJsonRpcServer& server) const;
+    void checkNotFrozen() const;
+    static std::string toMethodName(const QString& method);
+    QVariant executeObjectByParametersType(const QJsonObject& obj, const Function& currentFunc, const QJsonRpcCallContext& ctx);
+    QJsonValue executeObjectShared(const QJsonObject& obj, const Function& currentFunc, const QJsonRpcCallContext& ctx);
+    QVariant executeWithContext(const std::function<QVariant(const QJsonRpcCallContext&)>& call,
+                                const Function& currentFunc, const QJsonRpcCallContext& ctx,
+                                const QJsonRpcCancellationToken& token);
 
     QVariantList namesToParameterList(const QJsonObject& objectParameters, const Params& methodParamNames);
 
 
 
     void checkObject(const QJsonObject& obj);
-    void checkMethodParameters(const QJsonObject& params, const Params& paramNames);
+    static void checkMethodParameters(const QJsonObject& params, const Params& paramNames);
+    static std::vector<quint8> compileParamTypes(const QStringList& paramTypes);
+    static void checkParamCount(const QJsonValue& params, const Function& currentFunc);
+    static void checkParamTypes(const QJsonValue& params, const Function& currentFunc);
 };
 
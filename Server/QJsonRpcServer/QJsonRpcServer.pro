@@ -1,4 +1,4 @@
-QT = core
+QT = core network
 
 TEMPLATE = lib
 
@@ -6,6 +6,37 @@ TEMPLATE = lib
 CONFIG += c++17
 
 
-HEADERS += QJsonRpcServer.h
+HEADERS += QJsonRpcServer.h \
+    QJsonRpcResultCache.h \
+    QJsonRpcSingleFlight.h \
+    QJsonRpcScheduler.h \
+    QJsonRpcCallContext.h \
+    QJsonRpcPublisher.h \
+    QJsonRpcSocketTransport.h \
+    QJsonRpcHttpParser.h \
+    QJsonRpcHttpServer.h \
+    QJsonRpcScanner.h \
+    QJsonRpcParams.h \
+    QJsonRpcRouter.h \
+    QJsonRpcMethodTable.h \
+    QJsonRpcRecorder.h
 SOURCES += \
-    QJsonRpcServer.cpp
+    QJsonRpcServer.cpp \
+    QJsonRpcResultCache.cpp \
+    QJsonRpcSingleFlight.cpp \
+    QJsonRpcScheduler.cpp \
+    QJsonRpcCallContext.cpp \
+    QJsonRpcPublisher.cpp \
+    QJsonRpcSocketTransport.cpp \
+    QJsonRpcHttpParser.cpp \
+    QJsonRpcHttpServer.cpp \
+    QJsonRpcScanner.cpp \
+    QJsonRpcParams.cpp \
+    QJsonRpcRouter.cpp \
+    QJsonRpcRecorder.cpp
+
+qtHaveModule(websockets) {
+    QT += websockets
+    HEADERS += QJsonRpcWebSocketServer.h
+    SOURCES += QJsonRpcWebSocketServer.cpp
+}
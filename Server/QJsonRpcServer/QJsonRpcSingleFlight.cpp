@@ -0,0 +1,122 @@
+#include "QJsonRpcSingleFlight.h"
+
+#include <QMutexLocker>
+
+QJsonRpcSingleFlight::Result QJsonRpcSingleFlight::run(const QByteArray &key, const QJsonRpcSingleFlight::Call &call,
+                                                       QJsonValue &result, const QDeadlineTimer &deadline,
+                                                       const QJsonRpcCancellationToken &token)
+{
+    bool registered = false;
+
+    for(;;)
+    {
+        std::shared_ptr<Flight> flight;
+        {
+            QMutexLocker lock(&m_mutex);
+
+            flight = m_calls.value(key);
+            if(!flight)
+            {
+                flight = std::make_shared<Flight>();
+                m_calls.insert(key, flight);
+                break;
+            }
+            ++flight->waiters;
+        }
+
+        //wakes the waiters to look at their tokens. Registered without the lock,
+        //a cancelled token calls it right away
+        if(token.isValid() && !registered)
+        {
+            registered = true;
+            token.onCancelled([this]{
+                QMutexLocker lock(&m_mutex);
+                m_finished.wakeAll();
+            });
+        }
+
+        QMutexLocker lock(&m_mutex);
+        while(!flight->done)
+        {
+            if(token.isCancelled())
+            {
+                --flight->waiters;
+                return Result::Cancelled;
+            }
+
+            if(!m_finished.wait(&m_mutex, deadline) && !flight->done)
+            {
+                --flight->waiters;
+                return Result::Expired;
+            }
+        }
+        --flight->waiters;
+
+        if(flight->abandoned)
+            continue;
+
+        if(flight->error)
+            std::rethrow_exception(flight->error); //exception of the leader
+
+        result = flight->result;
+        return Result::Done;
+    }
+
+    //leader
+    QJsonValue value;
+    std::exception_ptr error;
+    bool abandoned = false;
+    try {
+        value = call();
+    }
+    catch(const Abandoned& abandon)
+    {
+        error = abandon.error;
+        abandoned = true;
+    }
+    catch(...)
+    {
+        error = std::current_exception();
+    }
+
+    {
+        QMutexLocker lock(&m_mutex);
+        const std::shared_ptr<Flight> flight = m_calls.take(key);
+        flight->result = value;
+        flight->error = error;
+        flight->abandoned = abandoned;
+        flight->done = true;
+        m_finished.wakeAll();
+    }
+
+    if(error)
+        std::rethrow_exception(error);
+
+    result = value;
+    return Result::Done;
+}
+
+int QJsonRpcSingleFlight::inFlight() const
+{
+    QMutexLocker lock(&m_mutex);
+
+    return m_calls.size();
+}
+
+int QJsonRpcSingleFlight::waiters(const QByteArray &key) const
+{
+    QMutexLocker lock(&m_mutex);
+
+    const std::shared_ptr<Flight> flight = m_calls.value(key);
+    return flight ? flight->waiters : 0;
+}
+
+int QJsonRpcSingleFlight::waiters() const
+{
+    QMutexLocker lock(&m_mutex);
+
+    int count = 0;
+    for(const auto& flight: m_calls)
+        count += flight->waiters;
+    return count;
+}
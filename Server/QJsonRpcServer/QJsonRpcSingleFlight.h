@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QByteArray>
+#include <QJsonValue>
+#include <QHash>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QDeadlineTimer>
+#include <exception>
+#include <functional>
+#include <memory>
+#include "QJsonRpcCallContext.h"
+
+
+/*
+    Shares one execution between concurrent calls with the same key.
+    The first caller runs the function, the others wait for its result
+    (or exception) until their own deadline or cancellation. Thread safe.
+    A function throwing Abandoned failed for a reason of its own caller,
+    e.g. the caller's deadline was over before the function ran: the
+    caller gets the wrapped exception and the waiting calls elect a new
+    leader instead of sharing it.
+*/
+class QJsonRpcSingleFlight
+{
+public:
+    using Call = std::function<QJsonValue()>;
+
+    struct Abandoned {
+        std::exception_ptr error;
+    };
+
+    enum class Result {
+        Done,
+        Expired,    //deadline of a waiting caller is over
+        Cancelled   //token of a waiting caller is cancelled
+    };
+
+    Result run(const QByteArray& key, const Call& call, QJsonValue& result,
+               const QDeadlineTimer& deadline = QDeadlineTimer(QDeadlineTimer::Forever),
+               const QJsonRpcCancellationToken& token = {});
+
+    int inFlight() const;
+    //Callers waiting for the running execution of the key, or of all keys
+    int waiters(const QByteArray& key) const;
+    int waiters() const;
+
+private:
+    struct Flight {
+        QJsonValue result;
+        std::exception_ptr error;
+        bool done {false};
+        bool abandoned {false};
+        int waiters {0};
+    };
+
+    QHash<QByteArray, std::shared_ptr<Flight>> m_calls;
+    mutable QMutex m_mutex;
+    QWaitCondition m_finished;
+};
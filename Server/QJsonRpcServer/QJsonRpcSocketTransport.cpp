@@ -0,0 +1,277 @@
+#include "QJsonRpcSocketTransport.h"
+#include "QJsonRpcServer.h"
+#include "QJsonRpcScanner.h"
+#include "QJsonRpcRecorder.h"
+
+#include <QAbstractSocket>
+#include <QLocalSocket>
+#include <QJsonDocument>
+#include <QThread>
+
+static const char plainLineTag       = 'J';
+static const char compressedLineTag  = 'Z';
+
+QJsonRpcSocketTransport::QJsonRpcSocketTransport(QJsonRpcServer &server, QIODevice *device, QObject *parent)
+    : QObject(parent)
+    , m_server{server}
+    , m_device{device}
+    , m_peer{QJsonRpcCallContext::newPeer()}
+{
+    connect(device, &QIODevice::readyRead, this, &QJsonRpcSocketTransport::onReadyRead);
+    connect(device, &QIODevice::bytesWritten, this, &QJsonRpcSocketTransport::onBytesWritten);
+    connect(device, &QIODevice::aboutToClose, this, &QJsonRpcSocketTransport::onAboutToClose);
+
+    applyReadBufferSize();
+}
+
+QJsonRpcSocketTransport::~QJsonRpcSocketTransport()
+{
+    if(m_publisher)
+        m_publisher->removeSubscriber(m_peer);
+}
+
+void QJsonRpcSocketTransport::setLimits(const QJsonRpcSocketTransport::Limits &limits)
+{
+    m_limits = limits;
+    applyReadBufferSize();
+}
+
+const QJsonRpcSocketTransport::Limits &QJsonRpcSocketTransport::limits() const
+{
+    return m_limits;
+}
+
+void QJsonRpcSocketTransport::setPublisher(QJsonRpcPublisher *publisher,
+                                           const QJsonRpcPublisher::SubscriberOptions &options)
+{
+    if(m_publisher)
+        m_publisher->removeSubscriber(m_peer);
+
+    m_publisher = publisher;
+    if(!m_publisher)
+    {
+        m_peer = QJsonRpcCallContext::newPeer();
+        return;
+    }
+
+    //removeSubscriber() waits for a running writer, so this outlives its calls
+    m_peer = m_publisher->addSubscriber([this](const QByteArray& message){
+        //publishing from another thread, the device is only touched from ours
+        if(QThread::currentThread() != thread())
+        {
+            if(m_marshalled.load() >= m_limits.highWatermark)
+                return false;
+
+            m_marshalled += message.size();
+            QMetaObject::invokeMethod(this, [this, message]{
+                m_marshalled -= message.size();
+                writeMessage(message);
+
+                //refused while over the marshalled watermark
+                if(m_publisher)
+                    m_publisher->flush(m_peer);
+            }, Qt::QueuedConnection);
+            return true;
+        }
+
+        //publisher keeps it queued until the connection drains
+        if(isBackedUp())
+            return false;
+
+        writeMessage(message);
+        return true;
+    }, options);
+}
+
+quint64 QJsonRpcSocketTransport::peer() const
+{
+    return m_peer;
+}
+
+void QJsonRpcSocketTransport::setRecorder(QJsonRpcRecorder *recorder)
+{
+    m_recorder = recorder;
+}
+
+bool QJsonRpcSocketTransport::isPaused() const
+{
+    return m_paused;
+}
+
+int QJsonRpcSocketTransport::inFlight() const
+{
+    return static_cast<int>(m_unflushed.size());
+}
+
+void QJsonRpcSocketTransport::onReadyRead()
+{
+    //data stays in the socket until the responses are flushed
+    if(m_paused)
+        return;
+
+    processMessages();
+}
+
+void QJsonRpcSocketTransport::onBytesWritten(qint64 bytes)
+{
+    while(bytes > 0 && !m_unflushed.empty())
+    {
+        if(m_unflushed.front() <= bytes)
+        {
+            bytes -= m_unflushed.front();
+            m_unflushed.pop_front();
+        }
+        else
+        {
+            m_unflushed.front() -= bytes;
+            bytes = 0;
+        }
+    }
+
+    if(!m_device)
+        return;
+
+    if(m_device->bytesToWrite() > m_limits.lowWatermark)
+        return;
+
+    if(static_cast<int>(m_unflushed.size()) >= m_limits.maxInFlight)
+        return;
+
+    //notifications refused while backed up, also without a pause
+    if(m_publisher)
+        m_publisher->flush(m_peer);
+
+    if(!m_paused)
+        return;
+
+    m_paused = false;
+    emit resumed();
+
+    processMessages();
+}
+
+void QJsonRpcSocketTransport::onAboutToClose()
+{
+    if(m_publisher)
+        m_publisher->removeSubscriber(m_peer);
+
+    m_publisher = nullptr;
+    m_buffer.clear();
+    m_position = 0;
+    m_scanned = 0;
+    m_unflushed.clear();
+}
+
+void QJsonRpcSocketTransport::processMessages()
+{
+    while(!m_paused && m_device && m_device->isOpen())
+    {
+        const qint64 found = QJsonRpcScanner::indexOf(m_buffer.constData() + m_scanned,
+                                                      m_buffer.size() - m_scanned, '\n');
+        const int end = found < 0 ? -1 : m_scanned + static_cast<int>(found);
+        if(end < 0)
+        {
+            m_scanned = m_buffer.size();
+
+            if(m_buffer.size() - m_position > m_limits.maxMessageSize)
+            {
+                emit protocolError();
+                m_device->close();
+                return;
+            }
+
+            if(m_device->bytesAvailable() <= 0)
+                return;
+
+            //drop consumed messages before the buffer grows
+            if(m_position > 0)
+            {
+                m_buffer.remove(0, m_position);
+                m_scanned -= m_position;
+                m_position = 0;
+            }
+            m_buffer.append(m_device->read(readChunkSize));
+            continue;
+        }
+
+        const QByteArray message = m_buffer.mid(m_position, end - m_position);
+        m_position = end + 1;
+        m_scanned = m_position;
+
+        executeMessage(message);
+        updatePaused();
+    }
+}
+
+void QJsonRpcSocketTransport::executeMessage(const QByteArray &message)
+{
+    //keep-alive empty lines
+    if(message.trimmed().isEmpty())
+        return;
+
+    const char tag = message.at(0);
+    const bool isFramed = tag == plainLineTag || tag == compressedLineTag;
+
+    //partial results and notifications of the call use the peer's framing
+    QJsonRpcCallContext call(QJsonValue::Undefined, QDeadlineTimer(QDeadlineTimer::Forever),
+                             [this, isFramed](const QJsonDocument& notification){
+        const QByteArray json = notification.toJson(QJsonDocument::Compact);
+        writeMessage(isFramed ? plainLineTag + json : json);
+    });
+    call.setPeer(m_peer);
+
+    const QByteArray response = tag == compressedLineTag
+            ? m_server.executeMessage(compressedLineTag + QByteArray::fromBase64(message.mid(1)), call)
+            : m_server.executeMessage(message, call);
+    //a compressed response is a line only in base64
+    const QByteArray line = response.startsWith(compressedLineTag)
+            ? compressedLineTag + response.mid(1).toBase64()
+            : response;
+
+    if(m_recorder)
+        m_recorder->record(message, line, QJsonRpcRecorder::Transport::Line, m_peer);
+
+    //notification
+    if(!line.isEmpty())
+        writeMessage(line);
+}
+
+void QJsonRpcSocketTransport::writeMessage(const QByteArray &message)
+{
+    if(!m_device || !m_device->isOpen())
+        return;
+
+    m_device->write(message);
+    m_device->write("\n", 1);
+    m_unflushed.push_back(message.size() + 1);
+
+    //unbuffered device wrote it already
+    if(m_device->bytesToWrite() == 0)
+        m_unflushed.clear();
+}
+
+bool QJsonRpcSocketTransport::isBackedUp() const
+{
+    if(!m_device)
+        return false;
+
+    return m_device->bytesToWrite() >= m_limits.highWatermark ||
+           static_cast<int>(m_unflushed.size()) >= m_limits.maxInFlight;
+}
+
+void QJsonRpcSocketTransport::updatePaused()
+{
+    if(m_paused || !isBackedUp())
+        return;
+
+    m_paused = true;
+    emit paused();
+}
+
+void QJsonRpcSocketTransport::applyReadBufferSize()
+{
+    if(auto socket = qobject_cast<QAbstractSocket*>(m_device.data()))
+        socket->setReadBufferSize(m_limits.readBufferSize);
+    else if(auto socket = qobject_cast<QLocalSocket*>(m_device.data()))
+        socket->setReadBufferSize(m_limits.readBufferSize);
+}
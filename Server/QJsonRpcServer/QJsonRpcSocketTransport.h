@@ -0,0 +1,100 @@
+#pragma once
+
+#include <QObject>
+#include <QIODevice>
+#include <QByteArray>
+#include <QPointer>
+#include <deque>
+#include <atomic>
+#include "QJsonRpcPublisher.h"
+
+class QJsonRpcServer;
+class QJsonRpcRecorder;
+
+
+/*
+    Newline delimited JSON-RPC over a stream device (QTcpSocket, QLocalSocket ...).
+    Every message is one line of compact JSON. Lines may use the framing of
+    QJsonRpcServer::executeMessage, 'J' + JSON or 'Z' + base64 of the
+    qCompress data, as compressed data may contain a newline.
+
+    Backpressure: reading of new requests stops while the device write buffer
+    is over the high watermark or too many written messages are not flushed
+    yet, and continues when both are back under the low limits. While paused
+    the socket read buffer is bounded, so the peer is slowed down by the
+    kernel flow control instead of growing our memory.
+
+    Responses are written with one QIODevice::write() each. QAbstractSocket
+    appends them to its write buffer and flushes it from the event loop, so
+    the responses of one read are already sent with a single system call.
+*/
+class QJsonRpcSocketTransport : public QObject
+{
+    Q_OBJECT
+public:
+    struct Limits {
+        qint64 highWatermark {4 * 1024 * 1024};
+        qint64 lowWatermark {1024 * 1024};
+        //responses and notifications written but not flushed yet
+        int maxInFlight {256};
+        //longer incoming line closes the connection
+        qint64 maxMessageSize {64 * 1024 * 1024};
+        //socket read buffer, 0 - unbounded
+        qint64 readBufferSize {1024 * 1024};
+    };
+
+    QJsonRpcSocketTransport(QJsonRpcServer& server, QIODevice* device, QObject* parent = nullptr);
+    ~QJsonRpcSocketTransport() override;
+
+    void setLimits(const Limits& limits);
+    const Limits& limits() const;
+
+    //Connection becomes a subscriber, its id is the peer of every call
+    void setPublisher(QJsonRpcPublisher* publisher,
+                      const QJsonRpcPublisher::SubscriberOptions& options = {});
+    quint64 peer() const;
+
+    //Every message and its response (empty for notifications) are recorded,
+    //the recorder must outlive the transport
+    void setRecorder(QJsonRpcRecorder* recorder);
+
+    bool isPaused() const;
+    int inFlight() const;
+
+signals:
+    void paused();
+    void resumed();
+    void protocolError();
+
+private slots:
+    void onReadyRead();
+    void onBytesWritten(qint64 bytes);
+    void onAboutToClose();
+
+private:
+    void processMessages();
+    void executeMessage(const QByteArray& message);
+    void writeMessage(const QByteArray& message);
+    bool isBackedUp() const;
+    void updatePaused();
+    void applyReadBufferSize();
+
+    static constexpr qint64 readChunkSize {64 * 1024};
+
+    QJsonRpcServer& m_server;
+    QPointer<QIODevice> m_device;
+    Limits m_limits;
+
+    QByteArray m_buffer;
+    int m_position {0};     //start of the next message in m_buffer
+    int m_scanned {0};      //m_buffer is scanned for '\n' up to this offset
+
+    std::deque<qint64> m_unflushed; //sizes of written messages
+    bool m_paused {false};
+
+    QJsonRpcPublisher* m_publisher {nullptr};
+    quint64 m_peer {0};
+    QJsonRpcRecorder* m_recorder {nullptr};
+    //bytes published from other threads and not written yet
+    std::atomic<qint64> m_marshalled {0};
+};
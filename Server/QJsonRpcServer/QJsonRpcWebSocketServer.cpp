@@ -0,0 +1,206 @@
+#include "QJsonRpcWebSocketServer.h"
+#include "QJsonRpcServer.h"
+#include "QJsonRpcRecorder.h"
+
+#include <QWebSocket>
+#include <QJsonDocument>
+#include <QPointer>
+#include <QThread>
+#include <atomic>
+#include <memory>
+
+QJsonRpcWebSocketServer::QJsonRpcWebSocketServer(QJsonRpcServer &server, QObject *parent)
+    : QObject(parent)
+    , m_server{server}
+    , m_webSocketServer{QStringLiteral("QJsonRpcServer"), QWebSocketServer::NonSecureMode}
+{
+    connect(&m_webSocketServer, &QWebSocketServer::newConnection, this, &QJsonRpcWebSocketServer::onNewConnection);
+}
+
+QJsonRpcWebSocketServer::~QJsonRpcWebSocketServer()
+{
+    if(!m_publisher)
+        return;
+
+    for(auto it = m_connections.cbegin(); it != m_connections.cend(); ++it)
+        m_publisher->removeSubscriber(it.value().peer);
+}
+
+bool QJsonRpcWebSocketServer::listen(const QHostAddress &address, quint16 port)
+{
+    return m_webSocketServer.listen(address, port);
+}
+
+void QJsonRpcWebSocketServer::close()
+{
+    m_webSocketServer.close();
+
+    const QList<QWebSocket*> sockets = m_connections.keys();
+    for(QWebSocket* socket: sockets)
+        socket->close();
+}
+
+quint16 QJsonRpcWebSocketServer::serverPort() const
+{
+    return m_webSocketServer.serverPort();
+}
+
+void QJsonRpcWebSocketServer::setMaxMessageSize(qint64 bytes)
+{
+    m_maxMessageSize = bytes;
+}
+
+void QJsonRpcWebSocketServer::setHighWatermark(qint64 bytes)
+{
+    m_highWatermark = bytes;
+}
+
+void QJsonRpcWebSocketServer::setPublisher(QJsonRpcPublisher *publisher,
+                                           const QJsonRpcPublisher::SubscriberOptions &options)
+{
+    m_publisher = publisher;
+    m_subscriberOptions = options;
+}
+
+void QJsonRpcWebSocketServer::setRecorder(QJsonRpcRecorder *recorder)
+{
+    m_recorder = recorder;
+}
+
+int QJsonRpcWebSocketServer::connectionCount() const
+{
+    return m_connections.size();
+}
+
+void QJsonRpcWebSocketServer::onNewConnection()
+{
+    while(QWebSocket* socket = m_webSocketServer.nextPendingConnection())
+    {
+        socket->setMaxAllowedIncomingMessageSize(static_cast<quint64>(m_maxMessageSize));
+
+        //browsers talk text until the peer sends something else
+        auto frames = std::make_shared<std::atomic<Frames>>(Frames::Text);
+        QJsonRpcPublisher::SubscriberId peer = QJsonRpcCallContext::newPeer();
+        if(m_publisher)
+        {
+            //bytes marshalled to the socket's thread and not sent yet
+            auto marshalled = std::make_shared<std::atomic<qint64>>(0);
+            //removeSubscriber() on disconnect waits for a running writer
+            peer = m_publisher->addSubscriber([this, socket, frames, marshalled](const QByteArray& message){
+                //publishing from another thread, the socket is only touched from ours
+                if(QThread::currentThread() != thread())
+                {
+                    if(marshalled->load() >= m_highWatermark)
+                        return false;
+
+                    *marshalled += message.size();
+                    QMetaObject::invokeMethod(this, [this, socket = QPointer<QWebSocket>(socket), frames, marshalled, message]{
+                        *marshalled -= message.size();
+                        if(!socket)
+                            return;
+                        sendMessage(socket, frames->load(), message);
+
+                        //refused while over the marshalled watermark
+                        if(m_publisher)
+                            m_publisher->flush(m_connections.value(socket).peer);
+                    }, Qt::QueuedConnection);
+                    return true;
+                }
+
+                //publisher keeps it queued until the connection drains
+                if(socket->bytesToWrite() >= m_highWatermark)
+                    return false;
+
+                sendMessage(socket, frames->load(), message);
+                return true;
+            }, m_subscriberOptions);
+
+            connect(socket, &QWebSocket::bytesWritten, this, [this, socket]{
+                if(m_publisher && socket->bytesToWrite() < m_highWatermark)
+                    m_publisher->flush(m_connections.value(socket).peer);
+            });
+        }
+        m_connections.insert(socket, Connection{peer, frames});
+
+        connect(socket, &QWebSocket::textMessageReceived, this, [this, socket](const QString& message){
+            onTextMessage(socket, message);
+        });
+        connect(socket, &QWebSocket::binaryMessageReceived, this, [this, socket](const QByteArray& message){
+            onBinaryMessage(socket, message);
+        });
+        connect(socket, &QWebSocket::disconnected, this, [this, socket]{
+            onDisconnected(socket);
+        });
+    }
+}
+
+void QJsonRpcWebSocketServer::onTextMessage(QWebSocket *socket, const QString &message)
+{
+    const QByteArray request = message.toUtf8();
+    m_connections.value(socket).frames->store(Frames::Text);
+    const QJsonDocument response = m_server.execute(QJsonDocument::fromJson(request), callContext(socket, Frames::Text));
+    const QByteArray json = response.isNull() ? QByteArray{} : response.toJson(QJsonDocument::Compact);
+
+    if(m_recorder)
+        m_recorder->record(request, json, QJsonRpcRecorder::Transport::WebSocketText,
+                           m_connections.value(socket).peer);
+
+    //notification
+    if(json.isEmpty())
+        return;
+
+    socket->sendTextMessage(QString::fromUtf8(json));
+}
+
+void QJsonRpcWebSocketServer::onBinaryMessage(QWebSocket *socket, const QByteArray &message)
+{
+    const Frames frames = message.startsWith('J') || message.startsWith('Z') ? Frames::Framed : Frames::Binary;
+    m_connections.value(socket).frames->store(frames);
+    const QByteArray response = m_server.executeMessage(message, callContext(socket, frames));
+
+    if(m_recorder)
+        m_recorder->record(message, response, QJsonRpcRecorder::Transport::WebSocketBinary,
+                           m_connections.value(socket).peer);
+
+    //notification
+    if(response.isEmpty())
+        return;
+
+    socket->sendBinaryMessage(response);
+}
+
+void QJsonRpcWebSocketServer::onDisconnected(QWebSocket *socket)
+{
+    const Connection connection = m_connections.take(socket);
+    if(m_publisher)
+        m_publisher->removeSubscriber(connection.peer);
+
+    socket->deleteLater();
+}
+
+QJsonRpcCallContext QJsonRpcWebSocketServer::callContext(QWebSocket *socket, Frames frames) const
+{
+    //partial results and notifications of a call go back like the request came
+    QJsonRpcCallContext call(QJsonValue::Undefined, QDeadlineTimer(QDeadlineTimer::Forever),
+                             [socket, frames](const QJsonDocument& notification){
+        sendMessage(socket, frames, notification.toJson(QJsonDocument::Compact));
+    });
+    call.setPeer(m_connections.value(socket).peer);
+    return call;
+}
+
+void QJsonRpcWebSocketServer::sendMessage(QWebSocket *socket, Frames frames, const QByteArray &json)
+{
+    switch(frames)
+    {
+    case Frames::Text:
+        socket->sendTextMessage(QString::fromUtf8(json));
+        break;
+    case Frames::Binary:
+        socket->sendBinaryMessage(json);
+        break;
+    case Frames::Framed:
+        socket->sendBinaryMessage('J' + json);
+        break;
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <QObject>
+#include <QWebSocketServer>
+#include <QHostAddress>
+#include <QHash>
+#include <atomic>
+#include <memory>
+#include "QJsonRpcPublisher.h"
+#include "QJsonRpcCallContext.h"
+
+class QJsonRpcServer;
+class QJsonRpcRecorder;
+class QWebSocket;
+
+
+/*
+    JSON-RPC over WebSocket, every frame carries one message or batch.
+    Text frames are plain JSON and are answered with text frames.
+    Binary frames use the QJsonRpcServer::executeMessage framing, so clients
+    can send and accept compressed messages ('Z' tag) with
+    QJsonRpcClient::toMessage / fromMessage.
+    Partial results and published notifications go out the way the peer
+    sent its last message: text frames, binary frames of plain JSON, or
+    'J' framed binary. Notifications are queued by the publisher while the
+    socket has more than the high watermark to write.
+    All connections are served by the thread the server lives in. A
+    notification published from another thread is handed to it, up to the
+    high watermark per connection.
+*/
+class QJsonRpcWebSocketServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit QJsonRpcWebSocketServer(QJsonRpcServer& server, QObject* parent = nullptr);
+    ~QJsonRpcWebSocketServer() override;
+
+    bool listen(const QHostAddress& address = QHostAddress::Any, quint16 port = 0);
+    void close();
+    quint16 serverPort() const;
+
+    //Larger incoming frames close the connection
+    void setMaxMessageSize(qint64 bytes);
+    //Pending bytes over which published notifications wait in the publisher
+    void setHighWatermark(qint64 bytes);
+    //Every connection becomes a subscriber, its id is the peer of every call
+    void setPublisher(QJsonRpcPublisher* publisher,
+                      const QJsonRpcPublisher::SubscriberOptions& options = {});
+
+    //Every message and its response (empty for notifications) are recorded,
+    //the recorder must outlive the server
+    void setRecorder(QJsonRpcRecorder* recorder);
+
+    int connectionCount() const;
+
+private:
+    void onNewConnection();
+    void onTextMessage(QWebSocket* socket, const QString& message);
+    void onBinaryMessage(QWebSocket* socket, const QByteArray& message);
+    void onDisconnected(QWebSocket* socket);
+    //Frames of the peer's last message, its notifications use the same
+    enum class Frames : quint8 {
+        Text,
+        Binary,
+        Framed  //binary with the executeMessage tag
+    };
+    struct Connection {
+        QJsonRpcPublisher::SubscriberId peer {0};
+        //read by writers on publishing threads
+        std::shared_ptr<std::atomic<Frames>> frames;
+    };
+
+    QJsonRpcCallContext callContext(QWebSocket* socket, Frames frames) const;
+    static void sendMessage(QWebSocket* socket, Frames frames, const QByteArray& json);
+
+    QJsonRpcServer& m_server;
+    QWebSocketServer m_webSocketServer;
+    QHash<QWebSocket*, Connection> m_connections;
+    qint64 m_maxMessageSize {64 * 1024 * 1024};
+    qint64 m_highWatermark {4 * 1024 * 1024};
+    QJsonRpcRecorder* m_recorder {nullptr};
+
+    QJsonRpcPublisher* m_publisher {nullptr};
+    QJsonRpcPublisher::SubscriberOptions m_subscriberOptions;
+};
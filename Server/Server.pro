@@ -2,4 +2,5 @@ TEMPLATE = subdirs
 
 SUBDIRS += \
     QJsonRpcServer \
-    tests
+    tests \
+    qjsonrpc-replay
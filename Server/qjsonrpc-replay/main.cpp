@@ -0,0 +1,146 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTcpSocket>
+#include <QTextStream>
+#include <memory>
+#include <stdexcept>
+
+#include "QJsonRpcRecorder.h"
+
+/*
+    qjsonrpc-replay [--connections N] [--fast] [--speed X] log host port
+
+    Replays a QJsonRpcRecorder log against a server speaking newline
+    delimited JSON-RPC over TCP (QJsonRpcSocketTransport). Messages recorded
+    on other transports are sent as lines in the same framing: compressed
+    ones as 'Z' + base64, plain JSON made compact. Notifications and partial
+    results of the server are skipped until the response of the request.
+*/
+
+static QByteArray toLine(const QByteArray& message)
+{
+    if(message.startsWith('Z'))
+        return 'Z' + message.mid(1).toBase64();
+    if(!message.contains('\n'))
+        return message;
+
+    //pretty printed HTTP or WebSocket body
+    const bool tagged = message.startsWith('J');
+    const QByteArray json = QJsonDocument::fromJson(tagged ? message.mid(1) : message).toJson(QJsonDocument::Compact);
+    return tagged ? 'J' + json : json;
+}
+
+//response line to the request, a batch is answered with an array
+static bool isResponse(const QJsonDocument& response, const QJsonDocument& request)
+{
+    if(response.isArray())
+        return request.isArray();
+
+    const QJsonObject object = response.object();
+    if(object.contains(QLatin1String("method")))
+        return false;
+
+    //a request the server could not parse is answered with a null id
+    const QJsonValue id = object.value(QLatin1String("id"));
+    if(object.contains(QLatin1String("error")) && id.isNull())
+        return true;
+
+    return request.isArray() || id == request.object().value(QLatin1String("id"));
+}
+
+static QJsonRpcReplayer::Target connectTcp(const QString& host, quint16 port)
+{
+    auto socket = std::make_shared<QTcpSocket>();
+    socket->connectToHost(host, port);
+    if(!socket->waitForConnected())
+        throw std::runtime_error(socket->errorString().toStdString());
+
+    return [socket](const QByteArray& message, bool expectsResponse){
+        socket->write(toLine(message));
+        socket->write("\n", 1);
+        if(!socket->waitForBytesWritten())
+            throw std::runtime_error("write failed");
+
+        if(!expectsResponse)
+            return QByteArray{};
+
+        const QJsonDocument request = QJsonDocument::fromJson(QJsonRpcRecorder::toJson(message));
+        for(;;)
+        {
+            while(!socket->canReadLine())
+                if(!socket->waitForReadyRead())
+                    throw std::runtime_error("read failed");
+
+            const QByteArray line = socket->readLine().trimmed();
+            const QByteArray response = QJsonRpcRecorder::toMessage(QJsonRpcRecorder::Transport::Line, line);
+            if(isResponse(QJsonDocument::fromJson(QJsonRpcRecorder::toJson(response)), request))
+                return response;
+        }
+    };
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("qjsonrpc-replay");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replays recorded JSON-RPC traffic and reports latency percentiles");
+    parser.addHelpOption();
+    parser.addPositionalArgument("log", "Log written by QJsonRpcRecorder");
+    parser.addPositionalArgument("host", "Server host");
+    parser.addPositionalArgument("port", "Server port");
+    const QCommandLineOption connectionsOption("connections", "Concurrent connections", "N", "1");
+    const QCommandLineOption fastOption("fast", "Send as fast as possible instead of the recorded rate");
+    const QCommandLineOption speedOption("speed", "Recorded rate multiplier", "X", "1");
+    parser.addOption(connectionsOption);
+    parser.addOption(fastOption);
+    parser.addOption(speedOption);
+    parser.process(app);
+
+    const QStringList arguments = parser.positionalArguments();
+    if(arguments.size() != 3)
+        parser.showHelp(1);
+
+    QFile log(arguments.at(0));
+    if(!log.open(QIODevice::ReadOnly))
+    {
+        QTextStream(stderr) << "Can not open " << arguments.at(0) << '\n';
+        return 1;
+    }
+
+    const std::vector<QJsonRpcRecorder::Record> records = QJsonRpcRecorder::read(&log);
+    if(records.empty())
+    {
+        QTextStream(stderr) << "No records in " << arguments.at(0) << '\n';
+        return 1;
+    }
+
+    QJsonRpcReplayer::Options options;
+    options.connections = parser.value(connectionsOption).toInt();
+    options.recordedRate = !parser.isSet(fastOption);
+    options.speed = parser.value(speedOption).toDouble();
+
+    const QString host = arguments.at(1);
+    const quint16 port = static_cast<quint16>(arguments.at(2).toUInt());
+
+    const QJsonRpcReplayer::Report report = QJsonRpcReplayer::replay(records, [&]{
+        return connectTcp(host, port);
+    }, options);
+
+    QTextStream out(stdout);
+    out << "requests   " << report.requests << '\n'
+        << "failures   " << report.failures << '\n'
+        << "seconds    " << report.seconds << '\n'
+        << "throughput " << report.throughput << " req/s\n"
+        << "p50        " << report.p50 << " us\n"
+        << "p90        " << report.p90 << " us\n"
+        << "p99        " << report.p99 << " us\n"
+        << "p99.9      " << report.p999 << " us\n"
+        << "max        " << report.max << " us\n";
+
+    return 0;
+}
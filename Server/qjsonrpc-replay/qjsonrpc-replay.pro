@@ -0,0 +1,24 @@
+TEMPLATE = app
+TARGET = qjsonrpc-replay
+
+QT = core network
+
+CONFIG += console
+CONFIG += thread
+CONFIG += c++17
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../QJsonRpcServer
+
+HEADERS += \
+        ../QJsonRpcServer/QJsonRpcRecorder.h
+
+SOURCES += \
+        main.cpp \
+        ../QJsonRpcServer/QJsonRpcRecorder.cpp \
+        ../QJsonRpcServer/QJsonRpcServer.cpp \
+        ../QJsonRpcServer/QJsonRpcResultCache.cpp \
+        ../QJsonRpcServer/QJsonRpcSingleFlight.cpp \
+        ../QJsonRpcServer/QJsonRpcScheduler.cpp \
+        ../QJsonRpcServer/QJsonRpcCallContext.cpp \
+        ../QJsonRpcServer/QJsonRpcParams.cpp
@@ -1,9 +1,12 @@
 #include "tst_json_rpc_server_test.h"
 
 #include <gtest/gtest.h>
+#include <QCoreApplication>
 
 int main(int argc, char *argv[])
 {
+    //event loop for the tests over loopback sockets
+    QCoreApplication app(argc, argv);
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
 }
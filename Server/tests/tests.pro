@@ -6,15 +6,39 @@ include(gtest_dependency.pri)
 
 TEMPLATE = app
 
-QT = core
+QT = core network
 
 CONFIG += thread
+CONFIG += c++17
 
 INCLUDEPATH += ../QJsonRpcServer
+INCLUDEPATH += ../../Client/QJsonRpcClient
 
 HEADERS += \
-        tst_json_rpc_server_test.h
+        tst_json_rpc_server_test.h \
+        ../QJsonRpcServer/QJsonRpcSocketTransport.h \
+        ../QJsonRpcServer/QJsonRpcHttpServer.h
 
 SOURCES += \
         main.cpp \
-        ../QJsonRpcServer/QJsonRpcServer.cpp
+        ../../Client/QJsonRpcClient/QJsonRpcClient.cpp \
+        ../QJsonRpcServer/QJsonRpcServer.cpp \
+        ../QJsonRpcServer/QJsonRpcResultCache.cpp \
+        ../QJsonRpcServer/QJsonRpcSingleFlight.cpp \
+        ../QJsonRpcServer/QJsonRpcScheduler.cpp \
+        ../QJsonRpcServer/QJsonRpcCallContext.cpp \
+        ../QJsonRpcServer/QJsonRpcPublisher.cpp \
+        ../QJsonRpcServer/QJsonRpcSocketTransport.cpp \
+        ../QJsonRpcServer/QJsonRpcHttpParser.cpp \
+        ../QJsonRpcServer/QJsonRpcHttpServer.cpp \
+        ../QJsonRpcServer/QJsonRpcScanner.cpp \
+        ../QJsonRpcServer/QJsonRpcParams.cpp \
+        ../QJsonRpcServer/QJsonRpcRouter.cpp \
+        ../QJsonRpcServer/QJsonRpcRecorder.cpp
+
+qtHaveModule(websockets) {
+    QT += websockets
+    DEFINES += QJSONRPC_WEBSOCKETS
+    HEADERS += ../QJsonRpcServer/QJsonRpcWebSocketServer.h
+    SOURCES += ../QJsonRpcServer/QJsonRpcWebSocketServer.cpp
+}
@@ -6,7 +6,31 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QJsonRpcServer.h>
+#include <QJsonRpcPublisher.h>
+#include <QJsonRpcSocketTransport.h>
+#include <QJsonRpcHttpParser.h>
+#include <QJsonRpcHttpServer.h>
+#include <QJsonRpcScanner.h>
+#include <QJsonRpcScheduler.h>
+#include <QJsonRpcRouter.h>
+#include <QJsonRpcRecorder.h>
+#include <QJsonRpcClient.h>
+#include <QBuffer>
+#include <QIODevice>
+#include <QCoreApplication>
+#include <QDeadlineTimer>
+#include <QTcpSocket>
+#include <QtEndian>
+#ifdef QJSONRPC_WEBSOCKETS
+#include <QJsonRpcWebSocketServer.h>
+#include <QWebSocket>
+#endif
 #include <vector>
+#include <thread>
+#include <future>
+#include <atomic>
+#include <mutex>
+#include <chrono>
 
 using namespace testing;
 
@@ -322,7 +346,7 @@ TEST_F(JsonRpcTest, Invalid_request_object)
 
 /*
 --> {"jsonrpc": "2.0", "method": "subtract", "params": {"INVALID": 42,"minuend": 42, "subtrahend": 23}, "id": 3}
-<-- {"jsonrpc": "2.0", "error": {"code": -32600, "message": "Invalid Request"}, "id": null}
+<-- {"jsonrpc": "2.0", "error": {"code": -32602, "message": "Invalid params"}, "id": 3}
 */
 TEST_F(JsonRpcTest, Invalid_parameters)
 {
@@ -334,10 +358,10 @@ TEST_F(JsonRpcTest, Invalid_parameters)
 
     QJsonDocument response({{"jsonrpc", "2.0"},
                             {"error", QJsonObject{
-                                 {"code", -32600},
-                                 {"message", "Invalid Request"}
+                                 {"code", -32602},
+                                 {"message", "Invalid params"}
                              }},
-                            {"id", QJsonValue::Null}});
+                            {"id", 3}});
     QJsonDocument result;
 
     //Act
@@ -349,7 +373,7 @@ TEST_F(JsonRpcTest, Invalid_parameters)
 
 /*
 --> {"jsonrpc": "2.0", "method": "subtract", "params": {"subtrahend": 23}, "id": 3}
-<-- {"jsonrpc": "2.0", "error": {"code": -32600, "message": "Invalid Request"}, "id": null}
+<-- {"jsonrpc": "2.0", "error": {"code": -32602, "message": "Invalid params"}, "id": 3}
 */
 TEST_F(JsonRpcTest, Paramenter_not_exists)
 {
@@ -361,10 +385,10 @@ TEST_F(JsonRpcTest, Paramenter_not_exists)
 
     QJsonDocument response({{"jsonrpc", "2.0"},
                             {"error", QJsonObject{
-                                 {"code", -32600},
-                                 {"message", "Invalid Request"}
+                                 {"code", -32602},
+                                 {"message", "Invalid params"}
                              }},
-                            {"id", QJsonValue::Null}});
+                            {"id", 3}});
     QJsonDocument result;
 
     //Act
@@ -649,3 +673,2264 @@ TEST_F(JsonRpcTest, Batch_all_notifications)
     EXPECT_EQ(hello_notify_param, 7);
 }
 
+
+/*
+--> {"jsonrpc": "2.0", "method": "subtract", "params": [42, 23], "id": 1}  //plain text, legacy peer
+<-- {"jsonrpc": "2.0", "result": 19, "id": 1}                             //plain text
+*/
+TEST_F(JsonRpcTest, Message_plain)
+{
+    //Arrange
+    const QByteArray request = R"({"jsonrpc": "2.0", "method": "subtract", "params": [42, 23], "id": 1})";
+
+    QJsonDocument response({{"jsonrpc", "2.0"}, {"result", 19}, {"id", 1}});
+    QByteArray result;
+
+    rpc->setCompressionThreshold(1);
+
+    //Act
+    result = rpc->executeMessage(request);
+
+    //Assert
+    ASSERT_EQ(QJsonDocument::fromJson(result), response);
+}
+
+/*
+--> 'J' + {"jsonrpc": "2.0", "method": "subtract", "params": [42, 23], "id": 1}
+<-- 'J' + {"jsonrpc": "2.0", "result": 19, "id": 1}  //below threshold
+*/
+TEST_F(JsonRpcTest, Message_small_response_is_not_compressed)
+{
+    //Arrange
+    const QByteArray request = R"(J{"jsonrpc": "2.0", "method": "subtract", "params": [42, 23], "id": 1})";
+
+    QJsonDocument response({{"jsonrpc", "2.0"}, {"result", 19}, {"id", 1}});
+    QByteArray result;
+
+    rpc->setCompressionThreshold(1024);
+
+    //Act
+    result = rpc->executeMessage(request);
+
+    //Assert
+    ASSERT_FALSE(result.isEmpty());
+    EXPECT_EQ(result.at(0), 'J');
+    EXPECT_EQ(QJsonDocument::fromJson(result.mid(1)), response);
+}
+
+/*
+--> 'Z' + qCompress({"jsonrpc": "2.0", "method": "range", "params": [10000], "id": 1})
+<-- 'Z' + qCompress({"jsonrpc": "2.0", "result": [0, 1, ..., 9999], "id": 1})
+*/
+TEST_F(JsonRpcTest, Message_large_response_is_compressed)
+{
+    //Arrange
+    const QByteArray json = R"({"jsonrpc": "2.0", "method": "range", "params": [10000], "id": 1})";
+    const QByteArray request = 'Z' + qCompress(json);
+
+    QJsonArray range;
+    for(int i = 0; i < 10000; ++i)
+        range.append(i);
+    QJsonDocument response({{"jsonrpc", "2.0"}, {"result", range}, {"id", 1}});
+    QByteArray result;
+
+    rpc->addMethod("range", {"count"}, [](const auto& args){
+        QVariantList res;
+        for(int i = 0; i < args[0].toInt(); ++i)
+            res.append(i);
+        return QVariant{res};
+    });
+    rpc->setCompressionThreshold(1024);
+
+    //Act
+    result = rpc->executeMessage(request);
+
+    //Assert
+    ASSERT_FALSE(result.isEmpty());
+    EXPECT_EQ(result.at(0), 'Z');
+    EXPECT_LT(result.size(), response.toJson(QJsonDocument::Compact).size());
+    EXPECT_EQ(QJsonDocument::fromJson(qUncompress(result.mid(1))), response);
+}
+
+/*
+--> 'Z' + size 0xFFFFFFFF + zlib data
+<-- 'J' + {"jsonrpc": "2.0", "error": {"code": -32700, "message": "Parse error"}, "id": null}
+*/
+TEST_F(JsonRpcTest, Message_compressed_size_over_limit)
+{
+    //Arrange
+    QByteArray request = 'Z' + qCompress(R"({"jsonrpc": "2.0", "method": "subtract", "params": [42, 23], "id": 1})");
+    request[1] = request[2] = request[3] = request[4] = '\xFF';
+
+    QJsonDocument response({{"jsonrpc", "2.0"},
+                            {"error", QJsonObject{
+                                 {"code", -32700},
+                                 {"message", "Parse error"}
+                             }},
+                            {"id", QJsonValue::Null}});
+    QByteArray result;
+
+    //Act
+    result = rpc->executeMessage(request);
+
+    //Assert
+    ASSERT_FALSE(result.isEmpty());
+    EXPECT_EQ(result.at(0), 'J');
+    EXPECT_EQ(QJsonDocument::fromJson(result.mid(1)), response);
+}
+
+/*
+--> 'J' + {"jsonrpc": "2.0", "method": "foobar"}
+<-- Nothing
+*/
+TEST_F(JsonRpcTest, Message_notification)
+{
+    //Arrange
+    const QByteArray request = R"(J{"jsonrpc": "2.0", "method": "foobar"})";
+    QByteArray result;
+
+    rpc->addMethod("foobar", {}, [](const auto& args){
+        Q_UNUSED(args)
+        return QVariant{};
+    });
+
+    //Act
+    result = rpc->executeMessage(request);
+
+    //Assert
+    EXPECT_TRUE(result.isEmpty());
+}
+
+/*
+--> {"jsonrpc": "2.0", "method": "square", "params": [3], "id": 1}
+<-- {"jsonrpc": "2.0", "result": 9, "id": 1}
+--> {"jsonrpc": "2.0", "method": "square", "params": [3], "id": 2}
+<-- {"jsonrpc": "2.0", "result": 9, "id": 2}     //from cache, handler is not called
+*/
+TEST_F(JsonRpcTest, Cacheable_method_hit)
+{
+    //Arrange
+    QJsonDocument request_first({{"jsonrpc", "2.0"}, {"method", "square"},
+                                 {"params", QJsonArray{3}}, {"id", 1}});
+    QJsonDocument request_second({{"jsonrpc", "2.0"}, {"method", "square"},
+                                  {"params", QJsonArray{3}}, {"id", 2}});
+
+    QJsonDocument response_first({{"jsonrpc", "2.0"}, {"result", 9}, {"id", 1}});
+    QJsonDocument response_second({{"jsonrpc", "2.0"}, {"result", 9}, {"id", 2}});
+
+    int calls{0};
+    QJsonRpcMethodOptions options;
+    options.cacheable = true;
+    rpc->addMethod("square", {"x"}, [&](const auto& args){
+        ++calls;
+        return args[0].toInt() * args[0].toInt();
+    }, options);
+
+    //Act
+    QJsonDocument result_first = rpc->execute(request_first);
+    QJsonDocument result_second = rpc->execute(request_second);
+
+    //Assert
+    EXPECT_EQ(result_first, response_first);
+    EXPECT_EQ(result_second, response_second);
+    EXPECT_EQ(calls, 1);
+    EXPECT_EQ(rpc->cacheStats("square").hits, 1u);
+    EXPECT_EQ(rpc->cacheStats("square").misses, 1u);
+}
+
+TEST_F(JsonRpcTest, Cacheable_method_named_parameters_order)
+{
+    //Arrange
+    QJsonDocument request_first({{"jsonrpc", "2.0"}, {"method", "div"},
+                                 {"params", QJsonObject{{"a", 8}, {"b", 2}}}, {"id", 1}});
+    QJsonDocument request_second({{"jsonrpc", "2.0"}, {"method", "div"},
+                                  {"params", QJsonObject{{"b", 2}, {"a", 8}}}, {"id", 2}});
+
+    int calls{0};
+    QJsonRpcMethodOptions options;
+    options.cacheable = true;
+    rpc->addMethod("div", {"a", "b"}, [&](const auto& args){
+        ++calls;
+        return args[0].toInt() / args[1].toInt();
+    }, options);
+
+    //Act
+    rpc->execute(request_first);
+    QJsonDocument result = rpc->execute(request_second);
+
+    //Assert
+    EXPECT_EQ(result, QJsonDocument({{"jsonrpc", "2.0"}, {"result", 4}, {"id", 2}}));
+    EXPECT_EQ(calls, 1);
+}
+
+TEST_F(JsonRpcTest, Cacheable_method_eviction)
+{
+    //Arrange
+    int calls{0};
+    QJsonRpcMethodOptions options;
+    options.cacheable = true;
+    options.cacheSize = 2;
+    rpc->addMethod("square", {"x"}, [&](const auto& args){
+        ++calls;
+        return args[0].toInt() * args[0].toInt();
+    }, options);
+
+    auto request = [](int x){
+        return QJsonDocument({{"jsonrpc", "2.0"}, {"method", "square"},
+                              {"params", QJsonArray{x}}, {"id", 1}});
+    };
+
+    //Act
+    rpc->execute(request(1));
+    rpc->execute(request(2));
+    rpc->execute(request(3)); //evicts 1
+    rpc->execute(request(1)); //evicts 2
+
+    //Assert
+    EXPECT_EQ(calls, 4);
+    EXPECT_EQ(rpc->cacheStats("square").evictions, 2u);
+    EXPECT_EQ(rpc->cacheStats("square").hits, 0u);
+}
+
+TEST_F(JsonRpcTest, Not_cacheable_method)
+{
+    //Arrange
+    QJsonDocument request({{"jsonrpc", "2.0"}, {"method", "subtract"},
+                           {"params", QJsonArray{42, 23}}, {"id", 1}});
+
+    //Act
+    rpc->execute(request);
+    rpc->execute(request);
+
+    //Assert
+    EXPECT_EQ(rpc->cacheStats("subtract").hits, 0u);
+    EXPECT_EQ(rpc->cacheStats("subtract").misses, 0u);
+}
+
+/*
+    Two concurrent identical requests share one handler execution,
+    each one is answered with its own id
+*/
+TEST_F(JsonRpcTest, Single_flight_concurrent_calls)
+{
+    //Arrange
+    QJsonDocument request_first({{"jsonrpc", "2.0"}, {"method", "slow"},
+                                 {"params", QJsonArray{21}}, {"id", 1}});
+    QJsonDocument request_second({{"jsonrpc", "2.0"}, {"method", "slow"},
+                                  {"params", QJsonArray{21}}, {"id", 2}});
+
+    QJsonDocument response_first({{"jsonrpc", "2.0"}, {"result", 42}, {"id", 1}});
+    QJsonDocument response_second({{"jsonrpc", "2.0"}, {"result", 42}, {"id", 2}});
+    QJsonDocument result_first;
+    QJsonDocument result_second;
+
+    std::atomic<int> calls{0};
+    std::promise<void> entered;
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+
+    QJsonRpcMethodOptions options;
+    options.singleFlight = true;
+    rpc->addMethod("slow", {"x"}, [&](const auto& args){
+        if(calls++ == 0)
+            entered.set_value();
+        released.wait();
+        return args[0].toInt() * 2;
+    }, options);
+
+    //Act
+    std::thread first([&]{ result_first = rpc->execute(request_first); });
+    entered.get_future().wait();
+    std::thread second([&]{ result_second = rpc->execute(request_second); });
+    QDeadlineTimer timeout(5000);
+    while(rpc->singleFlightWaiters("slow") == 0 && !timeout.hasExpired()) //the second call joined
+        std::this_thread::yield();
+    const bool joined = rpc->singleFlightWaiters("slow") > 0;
+    release.set_value();
+    first.join();
+    second.join();
+
+    //Assert
+    EXPECT_TRUE(joined);
+    EXPECT_EQ(result_first, response_first);
+    EXPECT_EQ(result_second, response_second);
+    EXPECT_EQ(calls, 1);
+}
+
+/*
+    A call waiting for the shared execution leaves at its own deadline
+<-- {"jsonrpc": "2.0", "error": {"code": -32000, "message": "Server error", "data": "Deadline exceeded"}, "id": 2}
+*/
+TEST_F(JsonRpcTest, Single_flight_follower_deadline)
+{
+    //Arrange
+    QJsonDocument request_first({{"jsonrpc", "2.0"}, {"method", "slow"},
+                                 {"params", QJsonArray{21}}, {"id", 1}});
+    QJsonDocument request_second({{"jsonrpc", "2.0"}, {"method", "slow"},
+                                  {"params", QJsonArray{21}}, {"id", 2}});
+
+    QJsonDocument response_first({{"jsonrpc", "2.0"}, {"result", 42}, {"id", 1}});
+    QJsonDocument response_second({{"jsonrpc", "2.0"},
+                                   {"error", QJsonObject{
+                                        {"code", -32000},
+                                        {"message", "Server error"},
+                                        {"data", "Deadline exceeded"}
+                                    }},
+                                   {"id", 2}});
+    QJsonDocument result_first;
+
+    std::promise<void> entered;
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+
+    QJsonRpcMethodOptions options;
+    options.singleFlight = true;
+    rpc->addMethod("slow", {"x"}, [&](const auto& args){
+        entered.set_value();
+        released.wait();
+        return args[0].toInt() * 2;
+    }, options);
+
+    //Act
+    std::thread first([&]{ result_first = rpc->execute(request_first); });
+    entered.get_future().wait();
+    const QJsonDocument result_second = rpc->execute(request_second, QDeadlineTimer(50));
+    release.set_value();
+    first.join();
+
+    //Assert
+    EXPECT_EQ(result_first, response_first);
+    EXPECT_EQ(result_second, response_second);
+}
+
+/*
+    "slow" allows one execution at a time, the second concurrent call fails fast
+<-- {"jsonrpc": "2.0", "error": {"code": -32000, "message": "Server error", "data": "Server busy"}, "id": 2}
+*/
+TEST_F(JsonRpcTest, Method_concurrency_limit_fail_fast)
+{
+    //Arrange
+    QJsonDocument request_first({{"jsonrpc", "2.0"}, {"method", "slow"}, {"id", 1}});
+    QJsonDocument request_second({{"jsonrpc", "2.0"}, {"method", "slow"}, {"id", 2}});
+
+    QJsonDocument response_first({{"jsonrpc", "2.0"}, {"result", 1}, {"id", 1}});
+    QJsonDocument response_second({{"jsonrpc", "2.0"},
+                                   {"error", QJsonObject{
+                                        {"code", -32000},
+                                        {"message", "Server error"},
+                                        {"data", "Server busy"}
+                                    }},
+                                   {"id", 2}});
+    QJsonDocument result_first;
+    QJsonDocument result_second;
+
+    std::promise<void> entered;
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+
+    QJsonRpcMethodOptions options;
+    options.maxConcurrency = 1;
+    rpc->addMethod("slow", {}, [&](const auto& args){
+        Q_UNUSED(args)
+        entered.set_value();
+        released.wait();
+        return 1;
+    }, options);
+
+    //Act
+    std::thread first([&]{ result_first = rpc->execute(request_first); });
+    entered.get_future().wait();
+    result_second = rpc->execute(request_second);
+    release.set_value();
+    first.join();
+
+    //Assert
+    EXPECT_EQ(result_first, response_first);
+    EXPECT_EQ(result_second, response_second);
+}
+
+TEST_F(JsonRpcTest, Server_in_flight_limit_bounded_wait)
+{
+    //Arrange
+    QJsonDocument request_slow({{"jsonrpc", "2.0"}, {"method", "slow"}, {"id", 1}});
+
+    QJsonDocument response_slow({{"jsonrpc", "2.0"}, {"result", 1}, {"id", 1}});
+    QJsonDocument response_subtract({{"jsonrpc", "2.0"}, {"result", 19}, {"id", 2}});
+    QJsonDocument result_slow;
+    QJsonDocument result_subtract;
+
+    std::promise<void> entered;
+
+    rpc->setMaxInFlight(1, 5000);
+    rpc->addMethod("slow", {}, [&](const auto& args){
+        Q_UNUSED(args)
+        entered.set_value();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        return 1;
+    });
+
+    //Act
+    std::thread first([&]{ result_slow = rpc->execute(request_slow); });
+    entered.get_future().wait();
+    result_subtract = rpc->execute(QJsonDocument({{"jsonrpc", "2.0"}, {"method", "subtract"},
+                                                  {"params", QJsonArray{42, 23}}, {"id", 2}}));
+    first.join();
+
+    //Assert
+    EXPECT_EQ(result_slow, response_slow);
+    EXPECT_EQ(result_subtract, response_subtract);
+}
+
+/*
+--> [
+        {"jsonrpc": "2.0", "method": "bulk", "id": 1},
+        {"jsonrpc": "2.0", "method": "subtract", "params": [42, 23], "id": 2},
+        {"jsonrpc": "2.0", "method": "health", "id": 3}
+    ]
+    execution order: health, subtract, bulk
+<-- [
+        {"jsonrpc": "2.0", "result": "bulk", "id": 1},
+        {"jsonrpc": "2.0", "result": 19, "id": 2},
+        {"jsonrpc": "2.0", "result": "ok", "id": 3}
+    ]
+*/
+TEST_F(JsonRpcTest, Batch_priority_order)
+{
+    //Arrange
+    const std::string request = R"([
+                                {"jsonrpc": "2.0", "method": "bulk", "id": 1},
+                                {"jsonrpc": "2.0", "method": "subtract", "params": [42, 23], "id": 2},
+                                {"jsonrpc": "2.0", "method": "health", "id": 3}
+                            ])";
+
+    QJsonDocument response(QJsonArray{
+                               QJsonObject{{"jsonrpc", "2.0"}, {"result", "bulk"}, {"id", 1}},
+                               QJsonObject{{"jsonrpc", "2.0"}, {"result", 19}, {"id", 2}},
+                               QJsonObject{{"jsonrpc", "2.0"}, {"result", "ok"}, {"id", 3}}
+                           });
+    QJsonDocument result;
+
+    std::vector<std::string> executed;
+
+    QJsonRpcServer server;
+    server.addMethod("subtract", {"subtrahend", "minuend"}, [&](const QVariantList& args) -> QVariant {
+        executed.push_back("subtract");
+        return args[0].toInt() - args[1].toInt();
+    });
+
+    QJsonRpcMethodOptions bulk_options;
+    bulk_options.priority = QJsonRpcMethodOptions::Priority::Bulk;
+    server.addMethod("bulk", {}, [&](const auto& args){
+        Q_UNUSED(args)
+        executed.push_back("bulk");
+        return QVariant{"bulk"};
+    }, bulk_options);
+
+    QJsonRpcMethodOptions control_options;
+    control_options.priority = QJsonRpcMethodOptions::Priority::Control;
+    server.addMethod("health", {}, [&](const auto& args){
+        Q_UNUSED(args)
+        executed.push_back("health");
+        return QVariant{"ok"};
+    }, control_options);
+
+    //Act
+    result = server.execute(request);
+
+    //Assert
+    EXPECT_EQ(result, response);
+    EXPECT_EQ(executed, (std::vector<std::string>{"health", "subtract", "bulk"}));
+}
+
+/*
+    With the only slot taken, waiting calls get it by priority, then by deadline
+*/
+TEST(JsonRpcSchedulerTest, Priority_then_deadline)
+{
+    //Arrange
+    QJsonRpcScheduler scheduler(1);
+    std::vector<std::string> admitted;
+    std::mutex admittedMutex;
+
+    auto call = [&](const std::string& name, QJsonRpcMethodOptions::Priority priority, int deadline){
+        return std::thread([&, name, priority, deadline]{
+            if(scheduler.acquire(static_cast<int>(priority), QDeadlineTimer(deadline), -1)
+                    != QJsonRpcScheduler::Result::Admitted)
+                return;
+            {
+                std::lock_guard<std::mutex> lock(admittedMutex);
+                admitted.push_back(name);
+            }
+            scheduler.release();
+        });
+    };
+
+    //Act
+    ASSERT_EQ(scheduler.acquire(static_cast<int>(QJsonRpcMethodOptions::Priority::Normal),
+                                QDeadlineTimer(QDeadlineTimer::Forever), 0),
+              QJsonRpcScheduler::Result::Admitted);
+    std::thread late = call("late", QJsonRpcMethodOptions::Priority::Normal, 60000);
+    std::thread bulk = call("bulk", QJsonRpcMethodOptions::Priority::Bulk, 30000);
+    std::thread early = call("early", QJsonRpcMethodOptions::Priority::Normal, 10000);
+    std::thread control = call("control", QJsonRpcMethodOptions::Priority::Control, 60000);
+    while(scheduler.waiting() < 4)
+        std::this_thread::yield();
+    scheduler.release();
+    for(auto* thread: {&late, &bulk, &early, &control})
+        thread->join();
+
+    //Assert
+    EXPECT_EQ(admitted, (std::vector<std::string>{"control", "early", "late", "bulk"}));
+    EXPECT_EQ(scheduler.available(), 1);
+}
+
+/*
+    Waiting without a timeout still ends at the deadline
+*/
+TEST(JsonRpcSchedulerTest, Wait_until_deadline)
+{
+    //Arrange
+    QJsonRpcScheduler scheduler(1);
+    ASSERT_EQ(scheduler.acquire(static_cast<int>(QJsonRpcMethodOptions::Priority::Normal),
+                                QDeadlineTimer(QDeadlineTimer::Forever), 0),
+              QJsonRpcScheduler::Result::Admitted);
+
+    //Act
+    const QJsonRpcScheduler::Result expired = scheduler.acquire(static_cast<int>(QJsonRpcMethodOptions::Priority::Normal),
+                                                                QDeadlineTimer(50), -1);
+    const QJsonRpcScheduler::Result busy = scheduler.acquire(static_cast<int>(QJsonRpcMethodOptions::Priority::Normal),
+                                                             QDeadlineTimer(60000), 50);
+    scheduler.release();
+
+    //Assert
+    EXPECT_EQ(expired, QJsonRpcScheduler::Result::Expired);
+    EXPECT_EQ(busy, QJsonRpcScheduler::Result::Busy);
+    EXPECT_EQ(scheduler.waiting(), 0);
+    EXPECT_EQ(scheduler.available(), 1);
+}
+
+/*
+--> {"jsonrpc": "2.0", "method": "subtract", "params": [42, 23], "id": 1} //deadline is over
+<-- {"jsonrpc": "2.0", "error": {"code": -32000, "message": "Server error", "data": "Deadline exceeded"}, "id": 1}
+*/
+TEST_F(JsonRpcTest, Deadline_exceeded)
+{
+    //Arrange
+    QJsonDocument request({{"jsonrpc", "2.0"}, {"method", "subtract"},
+                           {"params", QJsonArray{42, 23}}, {"id", 1}});
+
+    QJsonDocument response({{"jsonrpc", "2.0"},
+                            {"error", QJsonObject{
+                                 {"code", -32000},
+                                 {"message", "Server error"},
+                                 {"data", "Deadline exceeded"}
+                             }},
+                            {"id", 1}});
+    QJsonDocument result;
+
+    //Act
+    result = rpc->execute(request, QDeadlineTimer(0));
+
+    //Assert
+    ASSERT_EQ(result, response);
+}
+
+/*
+    "wait" runs until it is cancelled
+--> {"jsonrpc": "2.0", "method": "wait", "id": 7}
+--> {"jsonrpc": "2.0", "method": "$/cancelRequest", "params": {"id": 7}}
+<-- {"jsonrpc": "2.0", "error": {"code": -32000, "message": "Server error", "data": "Request cancelled"}, "id": 7}
+*/
+TEST_F(JsonRpcTest, Cancel_request)
+{
+    //Arrange
+    QJsonDocument request({{"jsonrpc", "2.0"}, {"method", "wait"}, {"id", 7}});
+    QJsonDocument cancel_request({{"jsonrpc", "2.0"}, {"method", "$/cancelRequest"},
+                                  {"params", QJsonObject{{"id", 7}}}});
+
+    QJsonDocument response({{"jsonrpc", "2.0"},
+                            {"error", QJsonObject{
+                                 {"code", -32000},
+                                 {"message", "Server error"},
+                                 {"data", "Request cancelled"}
+                             }},
+                            {"id", 7}});
+    QJsonDocument result;
+    QJsonDocument cancel_result;
+
+    std::promise<void> entered;
+    rpc->addMethodWithContext("wait", {}, [&](const QVariantList& args, const QJsonRpcCallContext& ctx){
+        Q_UNUSED(args)
+        std::promise<void> cancelled;
+        ctx.cancellationToken().onCancelled([&]{ cancelled.set_value(); });
+        entered.set_value();
+        cancelled.get_future().wait();
+        return QVariant{};
+    });
+
+    //Act
+    std::thread call([&]{ result = rpc->execute(request); });
+    entered.get_future().wait();
+    cancel_result = rpc->execute(cancel_request);
+    call.join();
+
+    //Assert
+    EXPECT_TRUE(cancel_result.isEmpty());
+    EXPECT_EQ(result, response);
+}
+
+/*
+    Request ids are unique per connection only, a peer cancels its own calls
+*/
+TEST_F(JsonRpcTest, Cancel_request_other_peer)
+{
+    //Arrange
+    QJsonDocument request({{"jsonrpc", "2.0"}, {"method", "wait"}, {"id", 7}});
+    QJsonDocument cancel_request({{"jsonrpc", "2.0"}, {"method", "$/cancelRequest"},
+                                  {"params", QJsonObject{{"id", 7}}}, {"id", 1}});
+    QJsonDocument not_cancelled({{"jsonrpc", "2.0"}, {"result", false}, {"id", 1}});
+    QJsonDocument cancelled({{"jsonrpc", "2.0"}, {"result", true}, {"id", 1}});
+
+    std::promise<void> entered;
+    rpc->addMethodWithContext("wait", {}, [&](const QVariantList& args, const QJsonRpcCallContext& ctx){
+        Q_UNUSED(args)
+        std::promise<void> cancelled;
+        ctx.cancellationToken().onCancelled([&]{ cancelled.set_value(); });
+        entered.set_value();
+        cancelled.get_future().wait();
+        return QVariant{};
+    });
+
+    QJsonRpcCallContext caller(QJsonValue::Undefined, QDeadlineTimer(QDeadlineTimer::Forever));
+    caller.setPeer(QJsonRpcCallContext::newPeer());
+    QJsonRpcCallContext other(QJsonValue::Undefined, QDeadlineTimer(QDeadlineTimer::Forever));
+    other.setPeer(QJsonRpcCallContext::newPeer());
+
+    //Act
+    std::thread call([&]{ rpc->execute(request, caller); });
+    entered.get_future().wait();
+    const QJsonDocument result_other = rpc->execute(cancel_request, other);
+    const QJsonDocument result_caller = rpc->execute(cancel_request, caller);
+    call.join();
+
+    //Assert
+    EXPECT_EQ(result_other, not_cancelled);
+    EXPECT_EQ(result_caller, cancelled);
+}
+
+/*
+    A call waiting for an execution slot is cancelled before its handler runs
+*/
+TEST_F(JsonRpcTest, Cancel_request_waiting_for_slot)
+{
+    //Arrange
+    QJsonDocument request_first({{"jsonrpc", "2.0"}, {"method", "slow"}, {"id", 1}});
+    QJsonDocument request_second({{"jsonrpc", "2.0"}, {"method", "slow"}, {"id", 2}});
+
+    QJsonDocument response_second({{"jsonrpc", "2.0"},
+                                   {"error", QJsonObject{
+                                        {"code", -32000},
+                                        {"message", "Server error"},
+                                        {"data", "Request cancelled"}
+                                    }},
+                                   {"id", 2}});
+    QJsonDocument result_second;
+
+    std::atomic<int> calls {0};
+    std::promise<void> entered;
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+
+    QJsonRpcMethodOptions options;
+    options.maxConcurrency = 1;
+    options.admissionTimeout = 5000;
+    rpc->addMethodWithContext("slow", {}, [&](const QVariantList& args, const QJsonRpcCallContext& ctx){
+        Q_UNUSED(args)
+        Q_UNUSED(ctx)
+        if(++calls == 1)
+            entered.set_value();
+        released.wait();
+        return QVariant{1};
+    }, options);
+
+    //Act
+    std::thread first([&]{ rpc->execute(request_first); });
+    entered.get_future().wait();
+    std::thread second([&]{ result_second = rpc->execute(request_second); });
+    while(!rpc->cancel(2)) //registered while it waits for the slot
+        std::this_thread::yield();
+    second.join(); //returns while the first call still holds the slot
+    release.set_value();
+    first.join();
+
+    //Assert
+    EXPECT_EQ(result_second, response_second);
+    EXPECT_EQ(calls, 1);
+}
+
+TEST_F(JsonRpcTest, Method_timeout)
+{
+    //Arrange
+    QJsonDocument request({{"jsonrpc", "2.0"}, {"method", "spin"}, {"id", 1}});
+
+    QJsonDocument response({{"jsonrpc", "2.0"},
+                            {"error", QJsonObject{
+                                 {"code", -32000},
+                                 {"message", "Server error"},
+                                 {"data", "Deadline exceeded"}
+                             }},
+                            {"id", 1}});
+    QJsonDocument result;
+
+    QJsonRpcMethodOptions options;
+    options.timeout = 20;
+    rpc->addMethodWithContext("spin", {}, [&](const QVariantList& args, const QJsonRpcCallContext& ctx){
+        Q_UNUSED(args)
+        while(!ctx.isCancelled())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return QVariant{};
+    }, options);
+
+    //Act
+    result = rpc->execute(request);
+
+    //Assert
+    ASSERT_EQ(result, response);
+}
+
+TEST_F(JsonRpcTest, Cancel_unknown_request)
+{
+    //Arrange
+    QJsonDocument cancel_request({{"jsonrpc", "2.0"}, {"method", "$/cancelRequest"},
+                                  {"params", QJsonArray{42}}, {"id", 1}});
+
+    QJsonDocument response({{"jsonrpc", "2.0"}, {"result", false}, {"id", 1}});
+    QJsonDocument result;
+
+    //Act
+    result = rpc->execute(cancel_request);
+
+    //Assert
+    ASSERT_EQ(result, response);
+}
+
+/*
+--> {"jsonrpc": "2.0", "method": "stream", "params": [3], "id": 1}
+<-- {"jsonrpc": "2.0", "method": "$/partialResult", "params": {"id": 1, "value": [0]}}
+<-- {"jsonrpc": "2.0", "method": "$/partialResult", "params": {"id": 1, "value": [1]}}
+<-- {"jsonrpc": "2.0", "method": "$/partialResult", "params": {"id": 1, "value": [2]}}
+<-- {"jsonrpc": "2.0", "result": 3, "id": 1}
+*/
+TEST_F(JsonRpcTest, Streaming_partial_results)
+{
+    //Arrange
+    QJsonDocument request({{"jsonrpc", "2.0"}, {"method", "stream"},
+                           {"params", QJsonArray{3}}, {"id", 1}});
+
+    QJsonDocument response({{"jsonrpc", "2.0"}, {"result", 3}, {"id", 1}});
+    QJsonDocument result;
+    std::vector<QJsonDocument> notifications;
+
+    rpc->addMethodWithContext("stream", {"count"}, [](const QVariantList& args, const QJsonRpcCallContext& ctx){
+        const int count = args[0].toInt();
+        for(int i = 0; i < count; ++i)
+            ctx.sendPartialResult(QJsonArray{i});
+        return QVariant{count};
+    });
+
+    //Act
+    result = rpc->execute(request, QDeadlineTimer(QDeadlineTimer::Forever),
+                          [&](const QJsonDocument& notification){
+        notifications.push_back(notification);
+    });
+
+    //Assert
+    EXPECT_EQ(result, response);
+    ASSERT_EQ(notifications.size(), 3u);
+    for(int i = 0; i < 3; ++i)
+    {
+        QJsonDocument partial({{"jsonrpc", "2.0"}, {"method", "$/partialResult"},
+                               {"params", QJsonObject{{"id", 1}, {"value", QJsonArray{i}}}}});
+        EXPECT_EQ(notifications[i], partial);
+    }
+}
+
+/*
+A refused message put back in front of the ones published meanwhile
+still counts against maxQueued
+*/
+TEST(JsonRpcPublisherTest, Refused_message_drop_oldest)
+{
+    //Arrange
+    QJsonRpcPublisher publisher;
+    QJsonRpcPublisher::SubscriberOptions options;
+    options.maxQueued = 2;
+    options.dropPolicy = QJsonRpcPublisher::DropPolicy::DropOldest;
+    bool publishing {false};
+    auto slow = publisher.addSubscriber([&](const QByteArray&){
+        //published while the first message is being written
+        if(!publishing)
+        {
+            publishing = true;
+            publisher.publish("tick", QJsonArray{2});
+            publisher.publish("tick", QJsonArray{3});
+        }
+        return false;
+    }, options);
+    publisher.subscribe(slow, "tick");
+
+    //Act
+    publisher.publish("tick", QJsonArray{1});
+
+    //Assert
+    EXPECT_EQ(publisher.queued(slow), 2);
+    EXPECT_EQ(publisher.stats().dropped, 1u);
+}
+
+/*
+    One serialised buffer is shared by all subscribers of the topic
+<-- {"jsonrpc": "2.0", "method": "news", "params": ["hello"]}
+*/
+TEST(JsonRpcPublisherTest, Publish_shared_buffer)
+{
+    //Arrange
+    QJsonRpcPublisher publisher;
+    QByteArray received_first;
+    QByteArray received_second;
+    QByteArray received_other;
+
+    auto first = publisher.addSubscriber([&](const QByteArray& message){ received_first = message; return true; });
+    auto second = publisher.addSubscriber([&](const QByteArray& message){ received_second = message; return true; });
+    auto other = publisher.addSubscriber([&](const QByteArray& message){ received_other = message; return true; });
+
+    publisher.subscribe(first, "news");
+    publisher.subscribe(second, "news");
+    publisher.subscribe(other, "weather");
+
+    //Act
+    int receivers = publisher.publish("news", QJsonArray{"hello"});
+
+    //Assert
+    EXPECT_EQ(receivers, 2);
+    EXPECT_EQ(QJsonDocument::fromJson(received_first),
+              QJsonDocument({{"jsonrpc", "2.0"}, {"method", "news"}, {"params", QJsonArray{"hello"}}}));
+    EXPECT_EQ(received_first.constData(), received_second.constData());
+    EXPECT_TRUE(received_other.isEmpty());
+}
+
+TEST(JsonRpcPublisherTest, Slow_subscriber_drop_oldest)
+{
+    //Arrange
+    QJsonRpcPublisher publisher;
+    bool writable{false};
+    std::vector<QByteArray> received;
+
+    QJsonRpcPublisher::SubscriberOptions options;
+    options.maxQueued = 2;
+    options.dropPolicy = QJsonRpcPublisher::DropPolicy::DropOldest;
+    auto slow = publisher.addSubscriber([&](const QByteArray& message){
+        if(!writable)
+            return false;
+        received.push_back(message);
+        return true;
+    }, options);
+    publisher.subscribe(slow, "tick");
+
+    //Act
+    publisher.publish("tick", QJsonArray{1});
+    publisher.publish("tick", QJsonArray{2});
+    publisher.publish("tick", QJsonArray{3}); //drops 1
+    writable = true;
+    publisher.flush(slow);
+
+    //Assert
+    ASSERT_EQ(received.size(), 2u);
+    EXPECT_EQ(QJsonDocument::fromJson(received[0]).object().value("params"), QJsonValue(QJsonArray{2}));
+    EXPECT_EQ(QJsonDocument::fromJson(received[1]).object().value("params"), QJsonValue(QJsonArray{3}));
+    EXPECT_EQ(publisher.stats().dropped, 1u);
+    EXPECT_EQ(publisher.queued(slow), 0);
+}
+
+TEST(JsonRpcPublisherTest, Slow_subscriber_disconnect)
+{
+    //Arrange
+    QJsonRpcPublisher publisher;
+
+    QJsonRpcPublisher::SubscriberOptions options;
+    options.maxQueued = 1;
+    options.dropPolicy = QJsonRpcPublisher::DropPolicy::Disconnect;
+    auto slow = publisher.addSubscriber([](const QByteArray&){ return false; }, options);
+    publisher.subscribe(slow, "tick");
+
+    //Act
+    publisher.publish("tick", QJsonArray{1});
+    publisher.publish("tick", QJsonArray{2});
+
+    //Assert
+    EXPECT_FALSE(publisher.hasSubscriber(slow));
+    EXPECT_EQ(publisher.stats().disconnected, 1u);
+}
+
+/*
+    Writers run without the publisher lock and may call back into it
+*/
+TEST(JsonRpcPublisherTest, Writer_calls_back)
+{
+    //Arrange
+    QJsonRpcPublisher publisher;
+    QJsonRpcPublisher::SubscriberId id {0};
+    std::vector<QByteArray> received;
+    id = publisher.addSubscriber([&](const QByteArray& message){
+        received.push_back(message);
+        publisher.unsubscribe(id, "once");
+        return true;
+    });
+    publisher.subscribe(id, "once");
+
+    //Act
+    const int first = publisher.publish("once", QJsonArray{1});
+    const int second = publisher.publish("once", QJsonArray{2});
+
+    //Assert
+    EXPECT_EQ(first, 1);
+    EXPECT_EQ(second, 0);
+    EXPECT_EQ(received.size(), 1u);
+    EXPECT_EQ(publisher.stats().delivered, 1u);
+}
+
+/*
+Removing a subscriber waits for its writer running on another thread
+*/
+TEST(JsonRpcPublisherTest, Remove_waits_for_writer)
+{
+    //Arrange
+    QJsonRpcPublisher publisher;
+    std::promise<void> entered;
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::atomic<bool> writing {false};
+    auto id = publisher.addSubscriber([&](const QByteArray&){
+        writing = true;
+        entered.set_value();
+        released.wait();
+        writing = false;
+        return true;
+    });
+    publisher.subscribe(id, "news");
+    std::thread publishing([&]{ publisher.publish("news", QJsonArray{1}); });
+    entered.get_future().wait();
+
+    //Act
+    auto removed = std::async(std::launch::async, [&]{ publisher.removeSubscriber(id); return writing.load(); });
+    const bool waited = removed.wait_for(std::chrono::milliseconds(50)) == std::future_status::timeout;
+    release.set_value();
+    const bool writingAfterRemove = removed.get();
+    publishing.join();
+
+    //Assert
+    EXPECT_TRUE(waited);
+    EXPECT_FALSE(writingAfterRemove);
+    EXPECT_FALSE(publisher.hasSubscriber(id));
+}
+
+/*
+--> {"jsonrpc": "2.0", "method": "rpc.subscribe", "params": {"topic": "news"}, "id": 1}
+<-- {"jsonrpc": "2.0", "result": true, "id": 1}
+*/
+TEST(JsonRpcPublisherTest, Subscribe_through_server)
+{
+    //Arrange
+    QJsonRpcServer rpc;
+    QJsonRpcPublisher publisher;
+    publisher.install(rpc);
+
+    QByteArray received;
+    auto peer = publisher.addSubscriber([&](const QByteArray& message){ received = message; return true; });
+
+    QJsonDocument request({{"jsonrpc", "2.0"}, {"method", "rpc.subscribe"},
+                           {"params", QJsonObject{{"topic", "news"}}}, {"id", 1}});
+    QJsonDocument response({{"jsonrpc", "2.0"}, {"result", true}, {"id", 1}});
+    QJsonRpcCallContext call(QJsonValue::Undefined, QDeadlineTimer(QDeadlineTimer::Forever));
+    call.setPeer(peer);
+
+    //Act
+    QJsonDocument result = rpc.execute(request, call);
+    publisher.publish("news", QJsonArray{"hello"});
+
+    //Assert
+    EXPECT_EQ(result, response);
+    EXPECT_FALSE(received.isEmpty());
+}
+
+/*
+    Stream device with a write buffer that is flushed by the test only
+*/
+class FakeSocket : public QIODevice
+{
+public:
+    QByteArray input;
+    QByteArray output;
+    qint64 pending {0};
+
+    FakeSocket()
+    {
+        open(QIODevice::ReadWrite);
+    }
+    bool isSequential() const override
+    {
+        return true;
+    }
+    qint64 bytesAvailable() const override
+    {
+        return input.size() + QIODevice::bytesAvailable();
+    }
+    qint64 bytesToWrite() const override
+    {
+        return pending;
+    }
+    void feed(const QByteArray& data)
+    {
+        input.append(data);
+        emit readyRead();
+    }
+    void flush(qint64 bytes)
+    {
+        pending -= bytes;
+        emit bytesWritten(bytes);
+    }
+protected:
+    qint64 readData(char* data, qint64 maxSize) override
+    {
+        const qint64 size = qMin<qint64>(maxSize, input.size());
+        memcpy(data, input.constData(), static_cast<size_t>(size));
+        input.remove(0, static_cast<int>(size));
+        return size;
+    }
+    qint64 writeData(const char* data, qint64 size) override
+    {
+        output.append(data, static_cast<int>(size));
+        pending += size;
+        return size;
+    }
+};
+
+/*
+--> {"jsonrpc": "2.0", "method": "subtract", "params": [42, 23], "id": 1}\n
+<-- {"jsonrpc":"2.0","id":1,"result":19}\n
+*/
+TEST_F(JsonRpcTest, Socket_transport_request)
+{
+    //Arrange
+    FakeSocket socket;
+    QJsonRpcSocketTransport transport(*rpc, &socket);
+
+    //Act
+    socket.feed(R"({"jsonrpc": "2.0", "method": "subtract", "params": [42, 23], "id": 1})" "\n");
+
+    //Assert
+    ASSERT_TRUE(socket.output.endsWith('\n'));
+    EXPECT_EQ(QJsonDocument::fromJson(socket.output.trimmed()),
+              QJsonDocument({{"jsonrpc", "2.0"}, {"result", 19}, {"id", 1}}));
+}
+
+/*
+--> 'Z' + base64(qCompress({"jsonrpc": "2.0", "method": "range", "params": [10000], "id": 1}))\n
+<-- 'Z' + base64(qCompress({"jsonrpc": "2.0", "result": [0, 1, ..., 9999], "id": 1}))\n
+*/
+TEST_F(JsonRpcTest, Socket_transport_compressed_line)
+{
+    //Arrange
+    FakeSocket socket;
+    QJsonRpcSocketTransport transport(*rpc, &socket);
+    const QByteArray json = R"({"jsonrpc": "2.0", "method": "range", "params": [10000], "id": 1})";
+
+    QJsonArray range;
+    for(int i = 0; i < 10000; ++i)
+        range.append(i);
+    QJsonDocument response({{"jsonrpc", "2.0"}, {"result", range}, {"id", 1}});
+
+    rpc->addMethod("range", {"count"}, [](const auto& args){
+        QVariantList res;
+        for(int i = 0; i < args[0].toInt(); ++i)
+            res.append(i);
+        return QVariant{res};
+    });
+    rpc->setCompressionThreshold(1024);
+
+    //Act
+    socket.feed('Z' + qCompress(json).toBase64() + '\n');
+
+    //Assert
+    ASSERT_TRUE(socket.output.startsWith('Z'));
+    EXPECT_EQ(socket.output.count('\n'), 1);
+    EXPECT_EQ(QJsonDocument::fromJson(qUncompress(QByteArray::fromBase64(socket.output.mid(1).trimmed()))), response);
+}
+
+/*
+    With 2 unflushed responses allowed, the third request waits in the device
+    until the client reads the responses
+*/
+TEST_F(JsonRpcTest, Socket_transport_backpressure)
+{
+    //Arrange
+    FakeSocket socket;
+    QJsonRpcSocketTransport transport(*rpc, &socket);
+    QJsonRpcSocketTransport::Limits limits;
+    limits.maxInFlight = 2;
+    limits.lowWatermark = 0;
+    transport.setLimits(limits);
+
+    const QByteArray request = R"({"jsonrpc": "2.0", "method": "subtract", "params": [42, 23], "id": 1})" "\n";
+
+    //Act
+    socket.feed(request + request + request);
+    const bool paused_after_two = transport.isPaused();
+    const int responses_after_two = socket.output.count('\n');
+    socket.flush(socket.pending);
+
+    //Assert
+    EXPECT_TRUE(paused_after_two);
+    EXPECT_EQ(responses_after_two, 2);
+    EXPECT_EQ(socket.output.count('\n'), 3);
+}
+
+/*
+    A notification published while the socket is over the high watermark
+    waits in the publisher and is written once the socket drains, although
+    the transport never paused reading
+*/
+TEST_F(JsonRpcTest, Socket_transport_publish_backed_up)
+{
+    //Arrange
+    FakeSocket socket;
+    QJsonRpcSocketTransport transport(*rpc, &socket);
+    QJsonRpcSocketTransport::Limits limits;
+    limits.highWatermark = 16;
+    limits.lowWatermark = 0;
+    transport.setLimits(limits);
+    QJsonRpcPublisher publisher;
+    transport.setPublisher(&publisher);
+    publisher.subscribe(transport.peer(), "news");
+    socket.pending = limits.highWatermark;
+
+    //Act
+    const int receivers = publisher.publish("news", QJsonArray{"hello"});
+    const int queued_while_backed_up = publisher.queued(transport.peer());
+    socket.flush(socket.pending);
+
+    //Assert
+    EXPECT_EQ(receivers, 1);
+    EXPECT_EQ(queued_while_backed_up, 1);
+    EXPECT_FALSE(transport.isPaused());
+    EXPECT_EQ(publisher.queued(transport.peer()), 0);
+    EXPECT_EQ(QJsonDocument::fromJson(socket.output.trimmed()),
+              QJsonDocument({{"jsonrpc", "2.0"}, {"method", "news"}, {"params", QJsonArray{"hello"}}}));
+}
+
+/*
+    Runs the event loop until the condition holds or the time is out
+*/
+template<typename Condition>
+bool waitFor(Condition condition, int milliseconds = 5000)
+{
+    QDeadlineTimer deadline(milliseconds);
+    while(!condition() && !deadline.hasExpired())
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+    return condition();
+}
+
+#ifdef QJSONRPC_WEBSOCKETS
+/*
+--> {"jsonrpc": "2.0", "method": "subtract", "params": [42, 23], "id": 1}
+<-- {"jsonrpc": "2.0", "result": 19, "id": 1}
+*/
+TEST_F(JsonRpcTest, WebSocket_request)
+{
+    //Arrange
+    QJsonRpcWebSocketServer server(*rpc);
+    ASSERT_TRUE(server.listen(QHostAddress::LocalHost));
+
+    QWebSocket client;
+    QString received;
+    QObject::connect(&client, &QWebSocket::textMessageReceived, [&](const QString& message){ received = message; });
+    client.open(QUrl(QStringLiteral("ws://127.0.0.1:%1").arg(server.serverPort())));
+    ASSERT_TRUE(waitFor([&]{ return client.state() == QAbstractSocket::ConnectedState; }));
+
+    //Act
+    client.sendTextMessage(QStringLiteral(R"({"jsonrpc": "2.0", "method": "subtract", "params": [42, 23], "id": 1})"));
+    waitFor([&]{ return !received.isEmpty(); });
+
+    //Assert
+    EXPECT_EQ(QJsonDocument::fromJson(received.toUtf8()),
+              QJsonDocument({{"jsonrpc", "2.0"}, {"result", 19}, {"id", 1}}));
+}
+
+/*
+--> {"jsonrpc": "2.0", "method": "rpc.subscribe", "params": {"topic": "news"}, "id": 1}
+<-- {"jsonrpc": "2.0", "result": true, "id": 1}
+<-- {"jsonrpc": "2.0", "method": "news", "params": ["hello"]}   (text frame, like the request)
+*/
+TEST_F(JsonRpcTest, WebSocket_subscribe_publish)
+{
+    //Arrange
+    QJsonRpcPublisher publisher;
+    publisher.install(*rpc);
+    QJsonRpcWebSocketServer server(*rpc);
+    server.setPublisher(&publisher);
+    ASSERT_TRUE(server.listen(QHostAddress::LocalHost));
+
+    QWebSocket client;
+    std::vector<QString> received;
+    int binary {0};
+    QObject::connect(&client, &QWebSocket::textMessageReceived, [&](const QString& message){ received.push_back(message); });
+    QObject::connect(&client, &QWebSocket::binaryMessageReceived, [&](const QByteArray&){ ++binary; });
+    client.open(QUrl(QStringLiteral("ws://127.0.0.1:%1").arg(server.serverPort())));
+    ASSERT_TRUE(waitFor([&]{ return client.state() == QAbstractSocket::ConnectedState; }));
+
+    //Act
+    client.sendTextMessage(QStringLiteral(R"({"jsonrpc": "2.0", "method": "rpc.subscribe", "params": {"topic": "news"}, "id": 1})"));
+    ASSERT_TRUE(waitFor([&]{ return received.size() == 1; }));
+    const int receivers = publisher.publish("news", QJsonArray{"hello"});
+    waitFor([&]{ return received.size() == 2; });
+
+    //Assert
+    ASSERT_EQ(received.size(), 2u);
+    EXPECT_EQ(QJsonDocument::fromJson(received[0].toUtf8()),
+              QJsonDocument({{"jsonrpc", "2.0"}, {"result", true}, {"id", 1}}));
+    EXPECT_EQ(receivers, 1);
+    EXPECT_EQ(QJsonDocument::fromJson(received[1].toUtf8()),
+              QJsonDocument({{"jsonrpc", "2.0"}, {"method", "news"}, {"params", QJsonArray{"hello"}}}));
+    EXPECT_EQ(binary, 0);
+}
+
+/*
+--> 'J' + {"jsonrpc": "2.0", "method": "stream", "params": [2], "id": 1}          (binary frame)
+<-- 'J' + {"jsonrpc": "2.0", "method": "$/partialResult", "params": {"id": 1, "value": 0}}
+<-- 'J' + {"jsonrpc": "2.0", "method": "$/partialResult", "params": {"id": 1, "value": 1}}
+<-- 'J' + {"jsonrpc": "2.0", "result": 2, "id": 1}
+*/
+TEST_F(JsonRpcTest, WebSocket_framed_partial_results)
+{
+    //Arrange
+    QJsonRpcWebSocketServer server(*rpc);
+    ASSERT_TRUE(server.listen(QHostAddress::LocalHost));
+    rpc->addMethodWithContext("stream", {"count"}, [](const QVariantList& args, const QJsonRpcCallContext& ctx){
+        for(int i = 0; i < args[0].toInt(); ++i)
+            ctx.sendPartialResult(i);
+        return QVariant{args[0].toInt()};
+    });
+
+    QWebSocket client;
+    std::vector<QByteArray> received;
+    int text {0};
+    QObject::connect(&client, &QWebSocket::binaryMessageReceived, [&](const QByteArray& message){ received.push_back(message); });
+    QObject::connect(&client, &QWebSocket::textMessageReceived, [&](const QString&){ ++text; });
+    client.open(QUrl(QStringLiteral("ws://127.0.0.1:%1").arg(server.serverPort())));
+    ASSERT_TRUE(waitFor([&]{ return client.state() == QAbstractSocket::ConnectedState; }));
+
+    //Act
+    client.sendBinaryMessage(QByteArray("J") + R"({"jsonrpc": "2.0", "method": "stream", "params": [2], "id": 1})");
+    waitFor([&]{ return received.size() == 3; });
+
+    //Assert
+    ASSERT_EQ(received.size(), 3u);
+    for(const QByteArray& message: received)
+        EXPECT_TRUE(message.startsWith('J'));
+    EXPECT_EQ(QJsonDocument::fromJson(received[1].mid(1)).object().value("method"), QJsonValue("$/partialResult"));
+    EXPECT_EQ(QJsonDocument::fromJson(received[2].mid(1)),
+              QJsonDocument({{"jsonrpc", "2.0"}, {"result", 2}, {"id", 1}}));
+    EXPECT_EQ(text, 0);
+}
+#endif
+
+/*
+    Lazy params: the handler reads one named field and forwards the rest untouched
+    --> {"jsonrpc": "2.0", "method": "forward", "params": {"target": "b", "payload": {"x": [1, 2]}}, "id": 1}
+    <-- {"jsonrpc": "2.0", "result": {"target": "b", "payload": {"x": [1, 2]}}, "id": 1}
+*/
+TEST_F(JsonRpcTest, Lazy_params_passthrough)
+{
+    //Arrange
+    QString target;
+    rpc->addMethodWithParams("forward", [&](const QJsonRpcParams& params, const QJsonRpcCallContext&) -> QVariant {
+        target = params.variant(QStringLiteral("target")).toString();
+        return QVariant::fromValue(params.raw());
+    });
+    const QJsonObject params {{"target", "b"}, {"payload", QJsonObject{{"x", QJsonArray{1, 2}}}}};
+
+    //Act
+    const QJsonDocument response = rpc->execute(QJsonDocument(
+        QJsonObject{{"jsonrpc", "2.0"}, {"method", "forward"}, {"params", params}, {"id", 1}}));
+
+    //Assert
+    EXPECT_EQ(target, QString("b"));
+    EXPECT_EQ(response, QJsonDocument({{"jsonrpc", "2.0"}, {"result", params}, {"id", 1}}));
+}
+
+TEST_F(JsonRpcTest, Lazy_params_positional)
+{
+    //Arrange
+    rpc->addMethodWithParams("second", [](const QJsonRpcParams& params, const QJsonRpcCallContext&) -> QVariant {
+        return params.variant(1);
+    });
+
+    //Act
+    const QJsonDocument response = rpc->execute(QJsonDocument::fromJson(
+        R"({"jsonrpc": "2.0", "method": "second", "params": [1, "two", 3], "id": 1})"));
+
+    //Assert
+    EXPECT_EQ(response, QJsonDocument({{"jsonrpc", "2.0"}, {"result", "two"}, {"id", 1}}));
+}
+
+/*
+    In-process channel: documents in and out, partial results go to the sink
+*/
+TEST_F(JsonRpcTest, Local_transport)
+{
+    //Arrange
+    rpc->addMethodWithContext("stream", {"count"}, [](const QVariantList& args, const QJsonRpcCallContext& ctx){
+        for(int i = 0; i < args[0].toInt(); ++i)
+            ctx.sendPartialResult(i);
+        return args[0];
+    });
+    int partials = 0;
+    const auto transport = rpc->localTransport([&](const QJsonDocument&){ ++partials; });
+
+    //Act
+    const QJsonDocument response = transport(QJsonDocument({{"jsonrpc", "2.0"}, {"method", "stream"},
+                                                            {"params", QJsonArray{3}}, {"id", 7}}));
+
+    //Assert
+    EXPECT_EQ(response, QJsonDocument({{"jsonrpc", "2.0"}, {"result", 3}, {"id", 7}}));
+    EXPECT_EQ(partials, 3);
+}
+
+/*
+    QJsonRpcClient over the local transport, partial results go to the
+    client through the sink and arrive before the response
+*/
+TEST_F(JsonRpcTest, Local_transport_client)
+{
+    //Arrange
+    rpc->addMethodWithContext("stream", {"count"}, [](const QVariantList& args, const QJsonRpcCallContext& ctx){
+        for(int i = 0; i < args[0].toInt(); ++i)
+            ctx.sendPartialResult(i);
+        return args[0];
+    });
+
+    QJsonRpcClient client;
+    client.setTimeout(1000);
+    std::vector<QJsonValue> partials;
+    client.setPartialResultHandler([&](const QJsonValue& id, const QJsonValue& value){
+        EXPECT_EQ(id, QJsonValue(2));
+        EXPECT_TRUE(client.isPending(2));
+        partials.push_back(value);
+    });
+    client.setTransport(rpc->localTransport([&client](const QJsonDocument& message){
+        client.handlePartialResult(message);
+    }));
+
+    //Act
+    const QJsonDocument subtract = client.call("subtract", QJsonArray{42, 23});
+    const QJsonDocument stream = client.call("stream", QJsonArray{3});
+
+    //Assert
+    EXPECT_EQ(subtract, QJsonDocument({{"jsonrpc", "2.0"}, {"result", 19}, {"id", 1}}));
+    EXPECT_EQ(stream, QJsonDocument({{"jsonrpc", "2.0"}, {"result", 3}, {"id", 2}}));
+    EXPECT_EQ(partials, (std::vector<QJsonValue>{0, 1, 2}));
+    EXPECT_EQ(client.pendingCount(), 0);
+}
+
+/*
+    Params of batch elements are handed over as shared views,
+    a handler can keep them after the call
+*/
+TEST_F(JsonRpcTest, Lazy_params_moved_out)
+{
+    //Arrange
+    std::vector<QJsonValue> kept;
+    rpc->addMethodWithParams("keep", [&](QJsonRpcParams params, const QJsonRpcCallContext&) -> QVariant {
+        const int size = params.array().size();
+        kept.push_back(params.take());
+        return params.isEmpty() ? size : -1;
+    });
+    QJsonArray large;
+    for(int i = 0; i < 1000; ++i)
+        large.append(i);
+    const QJsonDocument request(QJsonArray{
+                                    QJsonObject{{"jsonrpc", "2.0"}, {"method", "keep"}, {"params", large}, {"id", 1}},
+                                    QJsonObject{{"jsonrpc", "2.0"}, {"method", "keep"}, {"params", large}, {"id", 2}}
+                                });
+
+    //Act
+    const QJsonDocument response = rpc->execute(request);
+
+    //Assert
+    EXPECT_EQ(response, QJsonDocument(QJsonArray{
+                                          QJsonObject{{"jsonrpc", "2.0"}, {"result", 1000}, {"id", 1}},
+                                          QJsonObject{{"jsonrpc", "2.0"}, {"result", 1000}, {"id", 2}}
+                                      }));
+    ASSERT_EQ(kept.size(), 2u);
+    EXPECT_EQ(kept.front(), QJsonValue(large));
+}
+
+/*
+    Sub-servers mounted under "svc" and "svc.sub"
+    --> {"jsonrpc": "2.0", "method": "svc.sub.subtract", "params": [42, 23], "id": 1}
+    <-- {"jsonrpc": "2.0", "result": 19, "id": 1}
+*/
+TEST_F(JsonRpcTest, Mounted_sub_server)
+{
+    //Arrange
+    QJsonRpcServer svc;
+    svc.addMethodVariadicParameters("count", [](const QVariantList& args) -> QVariant {
+        return args.size();
+    });
+    QJsonRpcServer sub;
+    sub.addMethod("subtract", {"subtrahend", "minuend"}, [](const QVariantList& args) -> QVariant {
+        return args[0].toInt() - args[1].toInt();
+    });
+    rpc->mount("svc", svc);
+    rpc->mount("svc.sub.", sub);
+
+    //Act
+    const QJsonDocument nested = rpc->execute(QJsonDocument::fromJson(
+        R"({"jsonrpc": "2.0", "method": "svc.sub.subtract", "params": [42, 23], "id": 1})"));
+    const QJsonDocument mounted = rpc->execute(QJsonDocument::fromJson(
+        R"({"jsonrpc": "2.0", "method": "svc.count", "params": [1, 2, 3], "id": 2})"));
+    const QJsonDocument unknown = rpc->execute(QJsonDocument::fromJson(
+        R"({"jsonrpc": "2.0", "method": "svc.subtract", "params": [42, 23], "id": 3})"));
+
+    //Assert
+    EXPECT_EQ(nested, QJsonDocument({{"jsonrpc", "2.0"}, {"result", 19}, {"id", 1}}));
+    EXPECT_EQ(mounted, QJsonDocument({{"jsonrpc", "2.0"}, {"result", 3}, {"id", 2}}));
+    EXPECT_EQ(unknown.object().value("error").toObject().value("code"), QJsonValue(-32601));
+}
+
+/*
+    Frozen dispatch table finds own and mounted methods,
+    registration after freeze fails
+*/
+TEST_F(JsonRpcTest, Frozen_methods)
+{
+    //Arrange
+    QJsonRpcServer svc;
+    for(int i = 0; i < 100; ++i)
+        svc.addMethodVariadicParameters("op" + std::to_string(i), [i](const QVariantList&) -> QVariant {
+            return i;
+        });
+    rpc->mount("svc", svc);
+
+    //Act
+    rpc->freeze();
+    const QJsonDocument own = rpc->execute(QJsonDocument::fromJson(
+        R"({"jsonrpc": "2.0", "method": "subtract", "params": [42, 23], "id": 1})"));
+    const QJsonDocument mounted = rpc->execute(QJsonDocument::fromJson(
+        R"({"jsonrpc": "2.0", "method": "svc.op42", "id": 2})"));
+    const QJsonDocument unknown = rpc->execute(QJsonDocument::fromJson(
+        R"({"jsonrpc": "2.0", "method": "svc.op100", "id": 3})"));
+
+    //Assert
+    EXPECT_TRUE(rpc->isFrozen());
+    EXPECT_EQ(own, QJsonDocument({{"jsonrpc", "2.0"}, {"result", 19}, {"id", 1}}));
+    EXPECT_EQ(mounted, QJsonDocument({{"jsonrpc", "2.0"}, {"result", 42}, {"id", 2}}));
+    EXPECT_EQ(unknown.object().value("error").toObject().value("code"), QJsonValue(-32601));
+    EXPECT_THROW(rpc->addMethodVariadicParameters("late", [](const QVariantList&) -> QVariant { return {}; }),
+                 std::logic_error);
+}
+
+/*
+    Mounts can not form a cycle
+*/
+TEST(JsonRpcMountTest, Cycle_rejected)
+{
+    //Arrange
+    QJsonRpcServer root;
+    QJsonRpcServer svc;
+    QJsonRpcServer sub;
+    QJsonRpcServer other;
+    root.mount("svc", svc);
+    svc.mount("sub", sub);
+
+    //Act & Assert
+    EXPECT_THROW(root.mount("self", root), std::logic_error);
+    EXPECT_THROW(sub.mount("root", root), std::logic_error);
+    EXPECT_NO_THROW(sub.mount("other", other));
+}
+
+/*
+--> {"jsonrpc": "2.0", "method": "subtract", "params": [42], "id": 4}
+<-- {"jsonrpc": "2.0", "error": {"code": -32602, "message": "Invalid params"}, "id": 4}
+*/
+TEST_F(JsonRpcTest, Positional_arity_mismatch)
+{
+    //Arrange
+    QJsonDocument request({{"jsonrpc", "2.0"}, {"method", "subtract"},
+                           {"params", QJsonArray{42}}, {"id", 4}});
+
+    QJsonDocument response({{"jsonrpc", "2.0"},
+                            {"error", QJsonObject{
+                                 {"code", -32602},
+                                 {"message", "Invalid params"}
+                             }},
+                            {"id", 4}});
+    QJsonDocument result;
+
+    //Act
+    result = rpc->execute(request);
+
+    //Assert
+    ASSERT_EQ(result, response);
+}
+
+/*
+    Typed parameters are checked before the handler runs
+    --> {"jsonrpc": "2.0", "method": "repeat", "params": ["a", 2.5], "id": 1}
+    <-- {"jsonrpc": "2.0", "error": {"code": -32602, "message": "Invalid params"}, "id": 1}
+*/
+TEST_F(JsonRpcTest, Param_types_invalid_params)
+{
+    //Arrange
+    int calls = 0;
+    QJsonRpcMethodOptions options;
+    options.paramTypes = QStringList{"string", "integer"};
+    rpc->addMethod("repeat", {"value", "count"}, [&](const QVariantList& args) -> QVariant {
+        ++calls;
+        return args[0].toString().repeated(args[1].toInt());
+    }, options);
+
+    //Act
+    const QJsonDocument valid = rpc->execute(QJsonDocument::fromJson(
+        R"({"jsonrpc": "2.0", "method": "repeat", "params": {"value": "a", "count": 2}, "id": 1})"));
+    const QJsonDocument invalid = rpc->execute(QJsonDocument::fromJson(
+        R"({"jsonrpc": "2.0", "method": "repeat", "params": ["a", 2.5], "id": 2})"));
+
+    //Assert
+    EXPECT_EQ(valid, QJsonDocument({{"jsonrpc", "2.0"}, {"result", "aa"}, {"id", 1}}));
+    EXPECT_EQ(invalid, QJsonDocument({{"jsonrpc", "2.0"},
+                                      {"error", QJsonObject{{"code", -32602}, {"message", "Invalid params"}}},
+                                      {"id", 2}}));
+    EXPECT_EQ(calls, 1);
+}
+
+TEST_F(JsonRpcTest, Discover)
+{
+    //Arrange
+    QJsonRpcMethodOptions options;
+    options.paramTypes = QStringList{"integer", "integer"};
+    rpc->addMethod("typed_subtract", {"subtrahend", "minuend"}, [](const QVariantList& args) -> QVariant {
+        return args[0].toInt() - args[1].toInt();
+    }, options);
+
+    //Act
+    const QJsonDocument response = rpc->execute(QJsonDocument::fromJson(
+        R"({"jsonrpc": "2.0", "method": "rpc.discover", "id": 1})"));
+
+    //Assert
+    const QJsonArray methods = response.object().value("result").toObject().value("methods").toArray();
+    ASSERT_EQ(methods.size(), 2);
+    EXPECT_EQ(methods.at(0).toObject().value("name"), QJsonValue("subtract"));
+    EXPECT_EQ(methods.at(1).toObject().value("params").toArray().at(1),
+              QJsonValue(QJsonObject{{"name", "minuend"}, {"required", true},
+                                     {"schema", QJsonObject{{"type", "integer"}}}}));
+}
+
+static int tableSubtract(int subtrahend, int minuend)
+{
+    return subtrahend - minuend;
+}
+
+static QString tableJoin(QJsonArray values, QString separator)
+{
+    QStringList strings;
+    for(const auto& value: values)
+        strings.append(value.toString());
+    return strings.join(separator);
+}
+
+/*
+    Compile-time method table, positional and named parameters
+*/
+TEST(JsonRpcMethodTableTest, Static_dispatch)
+{
+    //Arrange
+    static constexpr QJsonRpcMethodTable methods {
+        qJsonRpcMethod("table.subtract", &tableSubtract, "subtrahend", "minuend"),
+        qJsonRpcMethod("table.join", &tableJoin, "values", "separator")
+    };
+    static_assert(methods.contains("table.join"));
+    QJsonRpcServer server;
+    server.addMethodTable(methods);
+
+    //Act
+    const QJsonDocument positional = server.execute(QJsonDocument::fromJson(
+        R"({"jsonrpc": "2.0", "method": "table.subtract", "params": [42, 23], "id": 1})"));
+    const QJsonDocument named = server.execute(QJsonDocument::fromJson(
+        R"({"jsonrpc": "2.0", "method": "table.join", "params": {"separator": "-", "values": ["a", "b"]}, "id": 2})"));
+    const QJsonDocument wrongType = server.execute(QJsonDocument::fromJson(
+        R"({"jsonrpc": "2.0", "method": "table.subtract", "params": ["42", 23], "id": 3})"));
+
+    //Assert
+    EXPECT_EQ(positional, QJsonDocument({{"jsonrpc", "2.0"}, {"result", 19}, {"id", 1}}));
+    EXPECT_EQ(named, QJsonDocument({{"jsonrpc", "2.0"}, {"result", "a-b"}, {"id", 2}}));
+    EXPECT_TRUE(wrongType.object().contains("error"));
+}
+
+/*
+    Integer parameters are not truncated or wrapped around
+*/
+TEST(JsonRpcMethodTableTest, Integer_params)
+{
+    //Arrange
+    static constexpr QJsonRpcMethodTable methods {
+        qJsonRpcMethod("table.subtract", &tableSubtract, "subtrahend", "minuend")
+    };
+    QJsonRpcServer server;
+    server.addMethodTable(methods);
+
+    //Act
+    const QJsonDocument fractional = server.execute(QJsonDocument::fromJson(
+        R"({"jsonrpc": "2.0", "method": "table.subtract", "params": [42.5, 23], "id": 1})"));
+    const QJsonDocument outOfRange = server.execute(QJsonDocument::fromJson(
+        R"({"jsonrpc": "2.0", "method": "table.subtract", "params": [4294967338, 23], "id": 2})"));
+
+    //Assert
+    EXPECT_EQ(fractional.object().value("error").toObject().value("code"), QJsonValue(-32602));
+    EXPECT_EQ(outOfRange.object().value("error").toObject().value("code"), QJsonValue(-32602));
+    EXPECT_THROW(QJsonRpcStatic::Decoder<qint64>::decode(QJsonValue(9223372036854775808.0)),
+                 QJsonRpcStatic::DecodeError);
+    EXPECT_EQ(QJsonRpcStatic::Decoder<qint64>::decode(QJsonValue(4294967338.0)), Q_INT64_C(4294967338));
+}
+
+/*
+    Unknown method is "Method not found" while the in-flight slots are taken,
+    tables of a mounted sub-server are served with its prefix
+*/
+TEST(JsonRpcMethodTableTest, Unknown_method_and_mount)
+{
+    //Arrange
+    static constexpr QJsonRpcMethodTable methods {
+        qJsonRpcMethod("table.subtract", &tableSubtract, "subtrahend", "minuend")
+    };
+    QJsonRpcServer sub;
+    sub.addMethodTable(methods);
+    QJsonRpcServer server;
+    server.addMethodTable(methods);
+    server.mount("svc", sub);
+    server.setMaxInFlight(1);
+
+    std::promise<void> entered;
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    server.addMethod("slow", {}, [&](const auto& args){
+        Q_UNUSED(args)
+        entered.set_value();
+        released.wait();
+        return 1;
+    });
+
+    //Act
+    std::thread slow([&]{ server.execute(QJsonDocument::fromJson(R"({"jsonrpc": "2.0", "method": "slow", "id": 1})")); });
+    entered.get_future().wait();
+    const QJsonDocument unknown = server.execute(QJsonDocument::fromJson(
+        R"({"jsonrpc": "2.0", "method": "table.unknown", "id": 2})"));
+    release.set_value();
+    slow.join();
+    const QJsonDocument mounted = server.execute(QJsonDocument::fromJson(
+        R"({"jsonrpc": "2.0", "method": "svc.table.subtract", "params": [42, 23], "id": 3})"));
+
+    //Assert
+    EXPECT_EQ(unknown.object().value("error").toObject().value("code"), QJsonValue(-32601));
+    EXPECT_EQ(mounted, QJsonDocument({{"jsonrpc", "2.0"}, {"result", 19}, {"id", 3}}));
+}
+
+/*
+    Newline is found at every offset, or not at all
+*/
+TEST(JsonRpcScannerTest, Index_of_newline)
+{
+    for(int size = 0; size < 100; ++size)
+    {
+        for(int position = 0; position <= size; ++position)
+        {
+            //Arrange
+            QByteArray data(size, 'x');
+            if(position < size)
+                data[position] = '\n';
+
+            //Act
+            const qint64 found = QJsonRpcScanner::indexOf(data.constData(), data.size(), '\n');
+
+            //Assert
+            EXPECT_EQ(found, position < size ? position : -1);
+        }
+    }
+}
+
+/*
+    HTTP/1.1 framing: two pipelined requests arrive in one read and are
+    taken out of the buffer one by one
+*/
+TEST(JsonRpcHttpParserTest, Pipelined_content_length)
+{
+    //Arrange
+    QJsonRpcHttpParser parser;
+    QJsonRpcHttpParser::Request first;
+    QJsonRpcHttpParser::Request second;
+    QJsonRpcHttpParser::Request third;
+    const QByteArray body = R"({"jsonrpc": "2.0", "method": "subtract", "params": [42, 23], "id": 1})";
+    const QByteArray request = "POST /rpc HTTP/1.1\r\nHost: localhost\r\nContent-Length: "
+            + QByteArray::number(body.size()) + "\r\n\r\n" + body;
+
+    //Act
+    parser.append(request + request.left(10));
+    const auto first_status = parser.next(first);
+    const auto second_status = parser.next(second);
+    parser.append(request.mid(10));
+    const auto third_status = parser.next(third);
+
+    //Assert
+    EXPECT_EQ(first_status, QJsonRpcHttpParser::Status::Complete);
+    EXPECT_TRUE(first.isPost);
+    EXPECT_TRUE(first.keepAlive);
+    EXPECT_EQ(first.target, QByteArray("/rpc"));
+    EXPECT_EQ(first.body, body);
+    EXPECT_EQ(second_status, QJsonRpcHttpParser::Status::Incomplete);
+    EXPECT_EQ(third_status, QJsonRpcHttpParser::Status::Complete);
+    EXPECT_EQ(third.body, body);
+    EXPECT_EQ(parser.buffered(), 0);
+}
+
+TEST(JsonRpcHttpParserTest, Chunked_body)
+{
+    //Arrange
+    QJsonRpcHttpParser parser;
+    QJsonRpcHttpParser::Request request;
+
+    //Act
+    parser.append("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\nConnection: close\r\n\r\n"
+                  "5\r\n{\"id\"\r\n"
+                  "3;ext=1\r\n:1}\r\n"
+                  "0\r\n\r\n");
+    const auto status = parser.next(request);
+
+    //Assert
+    EXPECT_EQ(status, QJsonRpcHttpParser::Status::Complete);
+    EXPECT_FALSE(request.keepAlive);
+    EXPECT_EQ(request.body, QByteArray(R"({"id":1})"));
+}
+
+TEST(JsonRpcHttpParserTest, Payload_too_large)
+{
+    //Arrange
+    QJsonRpcHttpParser parser(16);
+    QJsonRpcHttpParser::Request request;
+
+    //Act
+    parser.append("POST / HTTP/1.1\r\nContent-Length: 17\r\n\r\n");
+    const auto status = parser.next(request);
+
+    //Assert
+    EXPECT_EQ(status, QJsonRpcHttpParser::Status::PayloadTooLarge);
+}
+
+TEST(JsonRpcHttpParserTest, Bad_request)
+{
+    //Arrange
+    QJsonRpcHttpParser parser;
+    QJsonRpcHttpParser::Request request;
+
+    //Act
+    parser.append("POST /\r\nContent-Length: 2\r\n\r\n{}");
+    const auto status = parser.next(request);
+
+    //Assert
+    EXPECT_EQ(status, QJsonRpcHttpParser::Status::BadRequest);
+}
+
+/*
+    Framing headers two parsers could read differently are rejected
+*/
+TEST(JsonRpcHttpParserTest, Ambiguous_length)
+{
+    //Arrange
+    const QByteArray requests[] = {
+        "POST / HTTP/1.1\r\nContent-Length: 2\r\nContent-Length: 2\r\n\r\n{}",
+        "POST / HTTP/1.1\r\nContent-Length: 2\r\nContent-Length: 7\r\n\r\n{}",
+        "POST / HTTP/1.1\r\nContent-Length: 2\r\nTransfer-Encoding: chunked\r\n\r\n2\r\n{}\r\n0\r\n\r\n",
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\nContent-Length: 2\r\n\r\n2\r\n{}\r\n0\r\n\r\n",
+        "POST / HTTP/1.1\r\nTransfer-Encoding: gzip, chunked\r\n\r\n2\r\n{}\r\n0\r\n\r\n"
+    };
+
+    for(const QByteArray& data: requests)
+    {
+        QJsonRpcHttpParser parser;
+        QJsonRpcHttpParser::Request request;
+
+        //Act
+        parser.append(data);
+        const auto status = parser.next(request);
+
+        //Assert
+        EXPECT_EQ(status, QJsonRpcHttpParser::Status::BadRequest) << data.constData();
+    }
+}
+
+/*
+    "Expect: 100-continue" is reported once, before the body is there
+*/
+TEST(JsonRpcHttpParserTest, Expect_continue)
+{
+    //Arrange
+    QJsonRpcHttpParser parser;
+    QJsonRpcHttpParser::Request request;
+
+    //Act
+    parser.append("POST / HTTP/1.1\r\nExpect: 100-continue\r\nContent-Length: 2\r\n\r\n");
+    const auto headers_status = parser.next(request);
+    const bool expect_continue = parser.takeExpectContinue();
+    const auto again_status = parser.next(request);
+    const bool expect_continue_again = parser.takeExpectContinue();
+    parser.append("{}");
+    const auto body_status = parser.next(request);
+
+    //Assert
+    EXPECT_EQ(headers_status, QJsonRpcHttpParser::Status::Incomplete);
+    EXPECT_TRUE(expect_continue);
+    EXPECT_EQ(again_status, QJsonRpcHttpParser::Status::Incomplete);
+    EXPECT_FALSE(expect_continue_again);
+    EXPECT_EQ(body_status, QJsonRpcHttpParser::Status::Complete);
+    EXPECT_EQ(request.body, QByteArray("{}"));
+}
+
+/*
+    HTTP front end over a loopback connection, the client waits for
+    "100 Continue" before it sends the body
+*/
+TEST_F(JsonRpcTest, Http_server_expect_continue)
+{
+    //Arrange
+    QJsonRpcHttpServer server(*rpc);
+    ASSERT_TRUE(server.listen(QHostAddress::LocalHost));
+
+    QTcpSocket client;
+    QByteArray received;
+    QObject::connect(&client, &QTcpSocket::readyRead, [&]{ received.append(client.readAll()); });
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    ASSERT_TRUE(waitFor([&]{ return client.state() == QAbstractSocket::ConnectedState; }));
+
+    const QByteArray body = R"({"jsonrpc": "2.0", "method": "subtract", "params": [42, 23], "id": 1})";
+
+    //Act
+    client.write("POST / HTTP/1.1\r\nHost: localhost\r\nExpect: 100-continue\r\nContent-Length: "
+                 + QByteArray::number(body.size()) + "\r\n\r\n");
+    const bool continued = waitFor([&]{ return received.startsWith("HTTP/1.1 100 Continue\r\n\r\n"); });
+    received.clear();
+    client.write(body);
+    waitFor([&]{ return received.contains("\r\n\r\n") && received.endsWith('}'); });
+
+    //Assert
+    EXPECT_TRUE(continued);
+    EXPECT_TRUE(received.startsWith("HTTP/1.1 200 OK\r\n"));
+    EXPECT_EQ(QJsonDocument::fromJson(received.mid(received.indexOf("\r\n\r\n") + 4)),
+              QJsonDocument({{"jsonrpc", "2.0"}, {"result", 19}, {"id", 1}}));
+}
+
+/*
+    With a one byte high watermark every response pauses the reading of
+    the pipelined requests, all of them are answered once the client reads
+*/
+TEST_F(JsonRpcTest, Http_server_backpressure)
+{
+    //Arrange
+    QJsonRpcHttpServer server(*rpc);
+    server.setHighWatermark(1);
+    ASSERT_TRUE(server.listen(QHostAddress::LocalHost));
+
+    QTcpSocket client;
+    QByteArray received;
+    QObject::connect(&client, &QTcpSocket::readyRead, [&]{ received.append(client.readAll()); });
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    ASSERT_TRUE(waitFor([&]{ return client.state() == QAbstractSocket::ConnectedState; }));
+
+    const QByteArray body = R"({"jsonrpc": "2.0", "method": "subtract", "params": [42, 23], "id": 1})";
+    const QByteArray request = "POST / HTTP/1.1\r\nHost: localhost\r\nContent-Length: "
+            + QByteArray::number(body.size()) + "\r\n\r\n" + body;
+
+    //Act
+    client.write(request + request + request);
+    const bool answered = waitFor([&]{ return received.count("HTTP/1.1 200 OK") == 3 && received.endsWith('}'); });
+
+    //Assert
+    EXPECT_TRUE(answered);
+    EXPECT_EQ(client.state(), QAbstractSocket::ConnectedState);
+}
+
+/*
+    An HTTP/1.0 client asking for keep-alive is told the connection stays open
+*/
+TEST_F(JsonRpcTest, Http_server_http10_keep_alive)
+{
+    //Arrange
+    QJsonRpcHttpServer server(*rpc);
+    ASSERT_TRUE(server.listen(QHostAddress::LocalHost));
+
+    QTcpSocket client;
+    QByteArray received;
+    QObject::connect(&client, &QTcpSocket::readyRead, [&]{ received.append(client.readAll()); });
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    ASSERT_TRUE(waitFor([&]{ return client.state() == QAbstractSocket::ConnectedState; }));
+
+    const QByteArray body = R"({"jsonrpc": "2.0", "method": "subtract", "params": [42, 23], "id": 1})";
+
+    //Act
+    client.write("POST / HTTP/1.0\r\nConnection: keep-alive\r\nContent-Length: "
+                 + QByteArray::number(body.size()) + "\r\n\r\n" + body);
+    waitFor([&]{ return received.contains("\r\n\r\n") && received.endsWith('}'); });
+
+    //Assert
+    EXPECT_TRUE(received.startsWith("HTTP/1.1 200 OK\r\n"));
+    EXPECT_TRUE(received.contains("\r\nConnection: keep-alive\r\n"));
+    EXPECT_EQ(server.connectionCount(), 1);
+}
+
+/*
+    After a 400 the connection is closed and the rest is not parsed
+*/
+TEST_F(JsonRpcTest, Http_server_bad_request_closes)
+{
+    //Arrange
+    QJsonRpcHttpServer server(*rpc);
+    ASSERT_TRUE(server.listen(QHostAddress::LocalHost));
+
+    QTcpSocket client;
+    QByteArray received;
+    QObject::connect(&client, &QTcpSocket::readyRead, [&]{ received.append(client.readAll()); });
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    ASSERT_TRUE(waitFor([&]{ return client.state() == QAbstractSocket::ConnectedState; }));
+
+    //Act
+    client.write("POST /\r\nContent-Length: 2\r\n\r\n{}"
+                 "POST / HTTP/1.1\r\nContent-Length: 2\r\n\r\n{}");
+    const bool closed = waitFor([&]{ return client.state() == QAbstractSocket::UnconnectedState; });
+
+    //Assert
+    EXPECT_TRUE(closed);
+    EXPECT_TRUE(received.startsWith("HTTP/1.1 400 Bad Request\r\n"));
+    EXPECT_EQ(received.count("HTTP/1.1"), 1);
+}
+
+/*
+    A deflated body is decompressed, a client accepting deflate gets a
+    response over the compression threshold deflated
+*/
+TEST_F(JsonRpcTest, Http_server_deflate)
+{
+    //Arrange
+    QJsonRpcHttpServer server(*rpc);
+    ASSERT_TRUE(server.listen(QHostAddress::LocalHost));
+
+    rpc->addMethod("range", {"count"}, [](const auto& args){
+        QVariantList res;
+        for(int i = 0; i < args[0].toInt(); ++i)
+            res.append(i);
+        return QVariant{res};
+    });
+    rpc->setCompressionThreshold(1024);
+
+    QJsonArray range;
+    for(int i = 0; i < 10000; ++i)
+        range.append(i);
+    QJsonDocument response({{"jsonrpc", "2.0"}, {"result", range}, {"id", 1}});
+
+    QTcpSocket client;
+    QByteArray received;
+    QObject::connect(&client, &QTcpSocket::readyRead, [&]{ received.append(client.readAll()); });
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    ASSERT_TRUE(waitFor([&]{ return client.state() == QAbstractSocket::ConnectedState; }));
+
+    //zlib stream without the qCompress size
+    const QByteArray body = qCompress(R"({"jsonrpc": "2.0", "method": "range", "params": [10000], "id": 1})").mid(4);
+
+    //Act
+    client.write("POST / HTTP/1.1\r\nHost: localhost\r\nContent-Encoding: deflate\r\n"
+                 "Accept-Encoding: deflate\r\nContent-Length: " + QByteArray::number(body.size()) + "\r\n\r\n" + body);
+    waitFor([&]{
+        const int headersEnd = received.indexOf("\r\n\r\n");
+        const int lengthAt = received.indexOf("Content-Length: ");
+        if(headersEnd < 0 || lengthAt < 0)
+            return false;
+        const int length = received.mid(lengthAt + 16, received.indexOf("\r\n", lengthAt) - lengthAt - 16).toInt();
+        return received.size() - headersEnd - 4 >= length;
+    });
+    const QByteArray head = received.left(received.indexOf("\r\n\r\n"));
+    QByteArray compressed(4, '\0');
+    qToBigEndian<quint32>(1024 * 1024, compressed.data());
+    compressed.append(received.mid(head.size() + 4));
+
+    //Assert
+    EXPECT_TRUE(head.startsWith("HTTP/1.1 200 OK\r\n"));
+    EXPECT_TRUE(head.contains("\r\nContent-Encoding: deflate"));
+    EXPECT_EQ(QJsonDocument::fromJson(qUncompress(compressed)), response);
+}
+
+/*
+    Router with two backends, the batch is split between them and the
+    responses come back in the order of the requests
+*/
+class JsonRpcRouterTest : public ::testing::Test {
+
+protected:
+    QJsonRpcServer math;
+    QJsonRpcServer text;
+    QJsonRpcRouter router;
+
+    virtual void SetUp() override
+    {
+        math.addMethod("math.subtract", {"subtrahend", "minuend"}, [](const QVariantList& args) -> QVariant {
+            return args[0].toInt() - args[1].toInt();
+        });
+        text.addMethod("text.upper", {"value"}, [](const QVariantList& args) -> QVariant {
+            return args[0].toString().toUpper();
+        });
+
+        router.addRoute("math.", [this](const QByteArray& message){ return math.executeMessage(message); });
+        router.addRoute("text.", [this](const QByteArray& message){ return text.executeMessage(message); });
+    }
+};
+
+TEST_F(JsonRpcRouterTest, Single_request)
+{
+    //Arrange
+    const QByteArray request = R"({"jsonrpc": "2.0", "method": "math.subtract", "params": [42, 23], "id": 1})";
+
+    //Act
+    const QByteArray response = router.route(request);
+
+    //Assert
+    EXPECT_EQ(QJsonDocument::fromJson(response), QJsonDocument({{"jsonrpc", "2.0"}, {"result", 19}, {"id", 1}}));
+}
+
+/*
+    Only the top level "method" is read, the backend gets the bytes unchanged
+*/
+TEST_F(JsonRpcRouterTest, Single_request_passthrough)
+{
+    //Arrange
+    QByteArray received;
+    router.addRoute("echo.", [&](const QByteArray& message){
+        received = message;
+        return QByteArray(R"({"jsonrpc":"2.0","result":true,"id":1})");
+    });
+    const QByteArray request = R"({ "params": {"method": "math.subtract", "x": [1, "]"]},  "method" : "echo.all", "id": 1})";
+
+    //Act
+    const QByteArray response = router.route(request);
+
+    //Assert
+    EXPECT_EQ(received, request);
+    EXPECT_EQ(response, QByteArray(R"({"jsonrpc":"2.0","result":true,"id":1})"));
+}
+
+/*
+--> {"jsonrpc": "2.0", "method": "down.ping", "id": 1}
+<-- {"jsonrpc": "2.0", "error": {"code": -32000, "message": "Server error", "data": "Backend unavailable"}, "id": 1}
+*/
+TEST_F(JsonRpcRouterTest, Single_request_backend_failure)
+{
+    //Arrange
+    router.addRoute("down.", [](const QByteArray&) -> QByteArray {
+        throw std::runtime_error("connection refused");
+    });
+    QJsonDocument response({{"jsonrpc", "2.0"},
+                            {"error", QJsonObject{
+                                 {"code", -32000},
+                                 {"message", "Server error"},
+                                 {"data", "Backend unavailable"}
+                             }},
+                            {"id", 1}});
+
+    //Act
+    const QByteArray request_result = router.route(R"({"jsonrpc": "2.0", "method": "down.ping", "id": 1})");
+    const QByteArray notification_result = router.route(R"({"jsonrpc": "2.0", "method": "down.ping"})");
+
+    //Assert
+    EXPECT_EQ(QJsonDocument::fromJson(request_result), response);
+    EXPECT_TRUE(notification_result.isEmpty());
+}
+
+TEST_F(JsonRpcRouterTest, Batch_split_and_reassembled)
+{
+    //Arrange
+    const QByteArray request = R"([
+        {"jsonrpc": "2.0", "method": "text.upper", "params": ["a"], "id": "1"},
+        {"jsonrpc": "2.0", "method": "math.subtract", "params": [42, 23], "id": 2},
+        {"jsonrpc": "2.0", "method": "math.subtract", "params": [1, 1]},
+        {"jsonrpc": "2.0", "method": "unknown", "id": 3},
+        {"jsonrpc": "2.0", "method": "text.upper", "params": ["b"], "id": 4}
+    ])";
+
+    //Act
+    const QJsonArray response = QJsonDocument::fromJson(router.route(request)).array();
+
+    //Assert
+    ASSERT_EQ(response.size(), 4);
+    EXPECT_EQ(response.at(0).toObject().value("result"), QJsonValue("A"));
+    EXPECT_EQ(response.at(1).toObject().value("result"), QJsonValue(19));
+    EXPECT_EQ(response.at(2).toObject().value("error").toObject().value("code"), QJsonValue(-32601));
+    EXPECT_EQ(response.at(3).toObject().value("result"), QJsonValue("B"));
+}
+
+/*
+    Sub-batches of a mixed batch are sent at once, each backend sees the
+    other one running
+*/
+TEST_F(JsonRpcRouterTest, Batch_backends_in_parallel)
+{
+    //Arrange
+    std::atomic<int> running {0};
+    std::atomic<int> overlapped {0};
+    auto backend = [&](QJsonRpcServer& server){
+        return [&, target = &server](const QByteArray& message){
+            ++running;
+            QDeadlineTimer timeout(5000);
+            while(running < 2 && !timeout.hasExpired())
+                std::this_thread::yield();
+            if(running == 2)
+                ++overlapped;
+            return target->executeMessage(message);
+        };
+    };
+    QJsonRpcRouter parallel;
+    parallel.addRoute("math.", backend(math));
+    parallel.addRoute("text.", backend(text));
+
+    const QByteArray request = R"([
+        {"jsonrpc": "2.0", "method": "text.upper", "params": ["a"], "id": 1},
+        {"jsonrpc": "2.0", "method": "math.subtract", "params": [42, 23], "id": 2}
+    ])";
+
+    //Act
+    const QJsonArray response = QJsonDocument::fromJson(parallel.route(request)).array();
+
+    //Assert
+    EXPECT_EQ(overlapped, 2);
+    ASSERT_EQ(response.size(), 2);
+    EXPECT_EQ(response.at(0).toObject().value("result"), QJsonValue("A"));
+    EXPECT_EQ(response.at(1).toObject().value("result"), QJsonValue(19));
+}
+
+/*
+    Traffic recorded around the server is read back and replayed
+    over two connections
+*/
+TEST_F(JsonRpcTest, Record_and_replay)
+{
+    //Arrange
+    QBuffer log;
+    log.open(QIODevice::WriteOnly);
+    QJsonRpcRecorder recorder(&log);
+    const QByteArray request = R"({"jsonrpc": "2.0", "method": "subtract", "params": [42, 23], "id": 1})";
+    const QByteArray notification = R"({"jsonrpc": "2.0", "method": "subtract", "params": [42, 23]})";
+    for(int i = 0; i < 50; ++i)
+    {
+        recorder.execute(*rpc, request);
+        recorder.execute(*rpc, notification);
+    }
+    log.close();
+
+    std::atomic<int> sent {0};
+    QJsonRpcReplayer::Options options;
+    options.connections = 2;
+    options.recordedRate = false;
+
+    //Act
+    log.open(QIODevice::ReadOnly);
+    const auto records = QJsonRpcRecorder::read(&log);
+    const auto report = QJsonRpcReplayer::replay(records, [&]{
+        return [&](const QByteArray& message, bool) {
+            ++sent;
+            return rpc->executeMessage(message);
+        };
+    }, options);
+
+    //Assert
+    ASSERT_EQ(records.size(), 100u);
+    EXPECT_EQ(records.front().request, request);
+    EXPECT_EQ(QJsonDocument::fromJson(records.front().response),
+              QJsonDocument({{"jsonrpc", "2.0"}, {"result", 19}, {"id", 1}}));
+    EXPECT_TRUE(records.back().response.isEmpty());
+    EXPECT_EQ(report.requests, 100u);
+    EXPECT_EQ(report.failures, 0u);
+    EXPECT_EQ(sent, 100);
+    EXPECT_LE(report.p50, report.max);
+}
+
+/*
+    The socket transport records every line it served
+*/
+TEST_F(JsonRpcTest, Socket_transport_recorder)
+{
+    //Arrange
+    QBuffer log;
+    log.open(QIODevice::WriteOnly);
+    QJsonRpcRecorder recorder(&log);
+    FakeSocket socket;
+    QJsonRpcSocketTransport transport(*rpc, &socket);
+    transport.setRecorder(&recorder);
+    const QByteArray request = R"({"jsonrpc": "2.0", "method": "subtract", "params": [42, 23], "id": 1})";
+    const QByteArray notification = R"({"jsonrpc": "2.0", "method": "subtract", "params": [42, 23]})";
+
+    //Act
+    socket.feed(request + "\n" + notification + "\n");
+    log.close();
+    log.open(QIODevice::ReadOnly);
+    const auto records = QJsonRpcRecorder::read(&log);
+
+    //Assert
+    ASSERT_EQ(records.size(), 2u);
+    EXPECT_EQ(records[0].request, request);
+    EXPECT_EQ(records[0].response + '\n', socket.output);
+    EXPECT_EQ(records[0].transport, QJsonRpcRecorder::Transport::Line);
+    EXPECT_EQ(records[0].connection, transport.peer());
+    EXPECT_EQ(records[1].request, notification);
+    EXPECT_TRUE(records[1].response.isEmpty());
+}
+
+/*
+    Compressed lines are replayed in the executeMessage framing,
+    error responses are failures
+*/
+TEST_F(JsonRpcTest, Replay_line_framing_and_errors)
+{
+    //Arrange
+    rpc->setCompressionThreshold(1);
+    const QByteArray compressed = 'Z' + qCompress(R"({"jsonrpc": "2.0", "method": "subtract", "params": [42, 23], "id": 1})").toBase64();
+    const QByteArray unknown = R"({"jsonrpc": "2.0", "method": "unknown", "id": 2})";
+    std::vector<QJsonRpcRecorder::Record> records(2);
+    records[0].transport = QJsonRpcRecorder::Transport::Line;
+    records[0].request = compressed;
+    records[0].response = "recorded";
+    records[1].transport = QJsonRpcRecorder::Transport::WebSocketText;
+    records[1].request = unknown;
+    records[1].response = "recorded";
+
+    QJsonRpcReplayer::Options options;
+    options.recordedRate = false;
+    std::vector<QJsonDocument> responses;
+
+    //Act
+    const auto report = QJsonRpcReplayer::replay(records, [&]{
+        return [&](const QByteArray& message, bool) {
+            const QByteArray response = rpc->executeMessage(message);
+            responses.push_back(QJsonDocument::fromJson(QJsonRpcRecorder::toJson(response)));
+            return response;
+        };
+    }, options);
+
+    //Assert
+    ASSERT_EQ(responses.size(), 2u);
+    EXPECT_EQ(responses[0], QJsonDocument({{"jsonrpc", "2.0"}, {"result", 19}, {"id", 1}}));
+    EXPECT_EQ(report.requests, 2u);
+    EXPECT_EQ(report.failures, 1u);
+}